@@ -7,10 +7,10 @@ set -e
 
 CC=${CC:-gcc}
 CFLAGS="-Wall -Wextra -pedantic -std=c99 -g"
-LDFLAGS=""
+LDFLAGS="-lrt -lpthread"
 OUTPUT="timer"
 
-SOURCES="clock.c driver.c timer.c stdinout.c"
+SOURCES="clock.c driver.c timer.c timer_export.c timer_queue.c timer_shm.c stdinout.c"
 
 echo "=== Building Timer Application ==="
 echo "Compiler: $CC"
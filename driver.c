@@ -9,6 +9,7 @@
 #include "consts.h"
 #include "inout.h"
 #include "timer.h"
+#include "timer_shm.h"
 
 /*
  * BUG #8: RETURN OF STACK ADDRESS
@@ -91,7 +92,10 @@ void main_loop()
             break;
         case 2:
             print_string("Which timer should I nuke? > ");
-            delete_timer_record(get_input_digit());
+            /* user input: always use the checked path, even in TIMER_UNCHECKED builds */
+            if (ERROR_CODE == delete_timer_record_checked(get_input_digit())) {
+                print_string("\nNo such timer!\n");
+            }
             break;
         case 3:
             list_timers();
@@ -114,8 +118,12 @@ void main_loop()
 int main()
 {
     init_timer();     /* setup */
+    if (timer_shm_open(TIMER_SHM_NAME, TIMER_CAPACITY) == ERROR_CODE) {
+        print_string("Shared memory view unavailable ... continuing without it\n");
+    }
     main_loop();      /* loop until user quits */
     uninit_timer();   /* tear down */
+    timer_shm_close();
     return 0;
 }
 
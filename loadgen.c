@@ -0,0 +1,612 @@
+
+/*
+ * Load generator and throughput harness for the timer library.
+ * Synthesizes a mix of add/delete/list/export/watchdog/drain operations (or
+ * replays a recorded trace), runs it in-process against the timer store
+ * at a target rate or as fast as possible, and reports throughput,
+ * latency percentiles and memory growth.
+ *
+ * Trace format, one operation per line:
+ *     A <starttime> <endtime> <channel>   add a timer
+ *     D <index>                           delete the timer at index
+ *     L                                   list_timers()
+ *     X                                   export_timers()
+ *     W                                   start, kick and check the watchdog
+ *     E                                   drain the timer events due by now
+ *
+ * The load of a real timer process is captured in the same format by
+ * running it with TIMER_TRACE=<file> (add, delete, list and export only).
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "consts.h"
+#include "timer.h"
+
+#define NUM_OP_KINDS 6
+
+enum op_kind { OP_ADD, OP_DELETE, OP_LIST, OP_EXPORT, OP_WATCHDOG, OP_DRAIN };
+
+static const char op_codes[NUM_OP_KINDS] = { 'A', 'D', 'L', 'X', 'W', 'E' };
+
+struct load_op
+{
+    enum op_kind kind;
+    int index;              /* OP_DELETE */
+    long long starttime;    /* OP_ADD */
+    long long endtime;      /* OP_ADD */
+    unsigned channel;       /* OP_ADD */
+};
+
+/* where deletes land in the store */
+enum delete_dist { DEL_UNIFORM, DEL_HEAD, DEL_TAIL };
+
+/* when added timers start */
+enum hour_dist { HOUR_UNIFORM, HOUR_EVENING };
+
+struct load_config
+{
+    long num_ops;
+    double rate;                    /* ops per second, 0 = as fast as possible */
+    int weights[NUM_OP_KINDS];
+    enum delete_dist del_dist;
+    enum hour_dist hour_dist;
+    unsigned seed;
+    int export_threads;
+    const char* trace_in;
+    const char* trace_out;
+    int verbose;
+};
+
+static void usage(const char* prog)
+{
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  -n ops        number of operations to synthesize (default 100000)\n"
+            "  -r rate       target ops/sec, 0 = as fast as possible (default 0)\n"
+            "  -m weights    a,d,l,x,w,e weights of add,delete,list,export,watchdog,\n"
+            "                drain (default 40,30,15,5,5,5)\n"
+            "  -d dist       delete position: uniform, head, tail (default uniform)\n"
+            "  -H dist       start hour: uniform, evening (default uniform)\n"
+            "  -s seed       random seed (default 1)\n"
+            "  -t threads    export threads (default 4)\n"
+            "  -o file       record the synthesized trace to file\n"
+            "  -i file       replay the trace in file instead of synthesizing\n"
+            "  -v            keep the library's own output on stdout\n",
+            prog);
+}
+
+static double now_sec(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static long max_rss_kb(void)
+{
+    struct rusage ru;
+
+    if (getrusage(RUSAGE_SELF, &ru) != 0) {
+        return 0;
+    }
+    return ru.ru_maxrss;
+}
+
+static int parse_weights(const char* arg, int* weights)
+{
+    int n = sscanf(arg, "%d,%d,%d,%d,%d,%d", &weights[0], &weights[1],
+                   &weights[2], &weights[3], &weights[4], &weights[5]);
+    int i, total = 0;
+
+    if (n != NUM_OP_KINDS) {
+        return ERROR_CODE;
+    }
+    for (i = 0; i < NUM_OP_KINDS; i++) {
+        if (weights[i] < 0) {
+            return ERROR_CODE;
+        }
+        total += weights[i];
+    }
+    return (total > 0) ? 0 : ERROR_CODE;
+}
+
+static int parse_args(int argc, char** argv, struct load_config* cfg)
+{
+    int c;
+
+    cfg->num_ops = 100000;
+    cfg->rate = 0;
+    cfg->weights[OP_ADD] = 40;
+    cfg->weights[OP_DELETE] = 30;
+    cfg->weights[OP_LIST] = 15;
+    cfg->weights[OP_EXPORT] = 5;
+    cfg->weights[OP_WATCHDOG] = 5;
+    cfg->weights[OP_DRAIN] = 5;
+    cfg->del_dist = DEL_UNIFORM;
+    cfg->hour_dist = HOUR_UNIFORM;
+    cfg->seed = 1;
+    cfg->export_threads = 4;
+    cfg->trace_in = NULL;
+    cfg->trace_out = NULL;
+    cfg->verbose = 0;
+
+    while ((c = getopt(argc, argv, "n:r:m:d:H:s:t:o:i:v")) != -1) {
+        switch (c) {
+        case 'n':
+            cfg->num_ops = atol(optarg);
+            break;
+        case 'r':
+            cfg->rate = atof(optarg);
+            break;
+        case 'm':
+            if (parse_weights(optarg, cfg->weights) == ERROR_CODE) {
+                return ERROR_CODE;
+            }
+            break;
+        case 'd':
+            if (strcmp(optarg, "uniform") == 0) {
+                cfg->del_dist = DEL_UNIFORM;
+            } else if (strcmp(optarg, "head") == 0) {
+                cfg->del_dist = DEL_HEAD;
+            } else if (strcmp(optarg, "tail") == 0) {
+                cfg->del_dist = DEL_TAIL;
+            } else {
+                return ERROR_CODE;
+            }
+            break;
+        case 'H':
+            if (strcmp(optarg, "uniform") == 0) {
+                cfg->hour_dist = HOUR_UNIFORM;
+            } else if (strcmp(optarg, "evening") == 0) {
+                cfg->hour_dist = HOUR_EVENING;
+            } else {
+                return ERROR_CODE;
+            }
+            break;
+        case 's':
+            cfg->seed = (unsigned)strtoul(optarg, NULL, 10);
+            break;
+        case 't':
+            cfg->export_threads = atoi(optarg);
+            break;
+        case 'o':
+            cfg->trace_out = optarg;
+            break;
+        case 'i':
+            cfg->trace_in = optarg;
+            break;
+        case 'v':
+            cfg->verbose = 1;
+            break;
+        default:
+            return ERROR_CODE;
+        }
+    }
+
+    if (cfg->num_ops < 0 || cfg->rate < 0) {
+        return ERROR_CODE;
+    }
+    return 0;
+}
+
+/*
+ * Small deterministic PRNG (xorshift32) so traces are reproducible from a seed
+ */
+static unsigned rng_state;
+
+static unsigned rng_next(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+/* uniform in [0, n) */
+static int rng_below(int n)
+{
+    return (int)(rng_next() % (unsigned)n);
+}
+
+static enum op_kind pick_kind(const int* weights)
+{
+    int total = 0;
+    int i, r;
+
+    for (i = 0; i < NUM_OP_KINDS; i++) {
+        total += weights[i];
+    }
+    r = rng_below(total);
+    for (i = 0; i < NUM_OP_KINDS - 1; i++) {
+        if (r < weights[i]) {
+            break;
+        }
+        r -= weights[i];
+    }
+    return (enum op_kind)i;
+}
+
+static int pick_delete_index(enum delete_dist dist, int count)
+{
+    int window = (count < 8) ? count : 8;
+
+    switch (dist) {
+    case DEL_HEAD:
+        return rng_below(window);
+    case DEL_TAIL:
+        return count - 1 - rng_below(window);
+    default:
+        return rng_below(count);
+    }
+}
+
+static int pick_start_hour(enum hour_dist dist)
+{
+    /* Evening: most recordings start in prime time, 18:00-23:00 */
+    if (dist == HOUR_EVENING && rng_below(10) < 8) {
+        return 18 + rng_below(6);
+    }
+    return rng_below(24);
+}
+
+/*
+ * Build an operation trace, tracking the store size so deletes always
+ * target an existing record and adds are not issued into a full store
+ */
+static struct load_op* synthesize(const struct load_config* cfg)
+{
+    struct load_op* ops;
+    time_t midnight;
+    struct tm tm_tmp;
+    int count = 0;
+    long i;
+
+    ops = (struct load_op*)malloc(sizeof(struct load_op) * (size_t)(cfg->num_ops + 1));
+    if (ops == NULL) {
+        return NULL;
+    }
+
+    midnight = time(NULL);
+    localtime_r(&midnight, &tm_tmp);
+    tm_tmp.tm_hour = 0;
+    tm_tmp.tm_min = 0;
+    tm_tmp.tm_sec = 0;
+    midnight = mktime(&tm_tmp);
+
+    rng_state = cfg->seed ? cfg->seed : 1;
+    for (i = 0; i < cfg->num_ops; i++) {
+        struct load_op* op = &ops[i];
+        long long start;
+
+        memset(op, 0, sizeof(*op));
+        op->kind = pick_kind(cfg->weights);
+
+        if (op->kind == OP_ADD && count >= TIMER_CAPACITY) {
+            op->kind = OP_DELETE;
+        } else if (op->kind == OP_DELETE && count == 0) {
+            op->kind = OP_ADD;
+        }
+
+        if (op->kind == OP_ADD) {
+            start = (long long)midnight + pick_start_hour(cfg->hour_dist) * 3600LL +
+                    rng_below(60) * 60LL;
+            op->starttime = start;
+            op->endtime = start + (1 + rng_below(180)) * 60LL;
+            op->channel = (unsigned)rng_below(1000);
+            count++;
+        } else if (op->kind == OP_DELETE) {
+            op->index = pick_delete_index(cfg->del_dist, count);
+            count--;
+        }
+    }
+    return ops;
+}
+
+static int write_trace(const char* filename, const struct load_op* ops, long num_ops)
+{
+    FILE* fp;
+    long i;
+
+    fp = fopen(filename, "w");
+    if (fp == NULL) {
+        return ERROR_CODE;
+    }
+
+    for (i = 0; i < num_ops; i++) {
+        const struct load_op* op = &ops[i];
+
+        if (op->kind == OP_ADD) {
+            fprintf(fp, "A %lld %lld %u\n", op->starttime, op->endtime, op->channel);
+        } else if (op->kind == OP_DELETE) {
+            fprintf(fp, "D %d\n", op->index);
+        } else {
+            fprintf(fp, "%c\n", op_codes[op->kind]);
+        }
+    }
+
+    if (fclose(fp) != 0) {
+        return ERROR_CODE;
+    }
+    return 0;
+}
+
+/*
+ * Replayed times are untrusted: the store formats them with localtime_r,
+ * so reject any that do not fit time_t or that it cannot convert
+ */
+static int valid_time(long long t)
+{
+    time_t tt = (time_t)t;
+    struct tm tm_tmp;
+
+    return (long long)tt == t && localtime_r(&tt, &tm_tmp) != NULL;
+}
+
+static struct load_op* read_trace(const char* filename, long* num_ops)
+{
+    FILE* fp;
+    struct load_op* ops = NULL;
+    long n = 0, cap = 0;
+    char line[BUF_SIZE];
+
+    fp = fopen(filename, "r");
+    if (fp == NULL) {
+        return NULL;
+    }
+
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        struct load_op op;
+        int k;
+
+        if (line[0] == '\n' || line[0] == '#') {
+            continue;
+        }
+
+        memset(&op, 0, sizeof(op));
+        for (k = 0; k < NUM_OP_KINDS && op_codes[k] != line[0]; k++) {
+        }
+        if (k == NUM_OP_KINDS ||
+            (k == OP_ADD && sscanf(line + 1, "%lld %lld %u",
+                                   &op.starttime, &op.endtime, &op.channel) != 3) ||
+            (k == OP_ADD && (!valid_time(op.starttime) || !valid_time(op.endtime))) ||
+            (k == OP_DELETE && sscanf(line + 1, "%d", &op.index) != 1)) {
+            fprintf(stderr, "Bad trace line %ld: %s", n + 1, line);
+            free(ops);
+            fclose(fp);
+            return NULL;
+        }
+        op.kind = (enum op_kind)k;
+
+        if (n == cap) {
+            struct load_op* grown;
+
+            cap = cap ? cap * 2 : 1024;
+            grown = (struct load_op*)realloc(ops, sizeof(struct load_op) * (size_t)cap);
+            if (grown == NULL) {
+                free(ops);
+                fclose(fp);
+                return NULL;
+            }
+            ops = grown;
+        }
+        ops[n++] = op;
+    }
+
+    fclose(fp);
+    *num_ops = n;
+    if (ops == NULL) {
+        /* empty trace */
+        ops = (struct load_op*)malloc(sizeof(struct load_op));
+    }
+    return ops;
+}
+
+/*
+ * Apply one operation to the timer store
+ */
+static void run_op(const struct load_op* op, int export_fd, int export_threads)
+{
+    struct timer_event events[BUF_SIZE];
+    struct timer_record* tr;
+    int before;
+
+    switch (op->kind) {
+    case OP_ADD:
+        tr = timer_record_alloc();
+        if (tr == NULL) {
+            return;
+        }
+        tr->starttime = (time_t)op->starttime;
+        tr->endtime = (time_t)op->endtime;
+        tr->channel = op->channel;
+        before = timer_count();
+        add_timer_record(tr);
+        /* the store does not take the record when it is full */
+        if (timer_count() == before) {
+            timer_record_free(tr);
+        }
+        break;
+    case OP_DELETE:
+        /* replayed traces are untrusted and the store may be built unchecked */
+        if (op->index >= 0 && op->index < timer_count()) {
+            delete_timer_record(op->index);
+        }
+        break;
+    case OP_LIST:
+        list_timers();
+        break;
+    case OP_EXPORT:
+        export_timers(export_fd, export_threads);
+        break;
+    case OP_WATCHDOG:
+        if (!watchdog_is_enabled()) {
+            watchdog_init();
+        }
+        watchdog_kick();
+        watchdog_check();
+        break;
+    case OP_DRAIN:
+        while (timer_drain_expired(time(NULL), events, BUF_SIZE) == BUF_SIZE) {
+        }
+        break;
+    }
+}
+
+static int compare_double(const void* a, const void* b)
+{
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+
+    return (x > y) - (x < y);
+}
+
+static double percentile(const double* sorted, long n, double p)
+{
+    long idx;
+
+    if (n == 0) {
+        return 0;
+    }
+    idx = (long)(p / 100.0 * (double)(n - 1) + 0.5);
+    return sorted[idx];
+}
+
+int main(int argc, char** argv)
+{
+    struct load_config cfg;
+    struct load_op* ops;
+    long num_ops;
+    long counts[NUM_OP_KINDS] = { 0 };
+    double* latencies;
+    double start, elapsed, scheduled;
+    long rss_before, rss_after;
+    int export_fd;
+    FILE* report;
+    long i;
+
+    if (parse_args(argc, argv, &cfg) == ERROR_CODE) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (cfg.trace_in != NULL) {
+        ops = read_trace(cfg.trace_in, &num_ops);
+        if (ops == NULL) {
+            fprintf(stderr, "Cannot read trace %s\n", cfg.trace_in);
+            return 1;
+        }
+    } else {
+        num_ops = cfg.num_ops;
+        ops = synthesize(&cfg);
+        if (ops == NULL) {
+            fprintf(stderr, "Out of memory\n");
+            return 1;
+        }
+    }
+
+    if (cfg.trace_out != NULL && write_trace(cfg.trace_out, ops, num_ops) == ERROR_CODE) {
+        fprintf(stderr, "Cannot write trace %s\n", cfg.trace_out);
+        free(ops);
+        return 1;
+    }
+
+    latencies = (double*)malloc(sizeof(double) * (size_t)(num_ops + 1));
+    if (latencies == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        free(ops);
+        return 1;
+    }
+
+    /* Report on the real stdout, silence the library's own output */
+    report = fdopen(dup(STDOUT_FILENO), "w");
+    if (report == NULL) {
+        report = stderr;
+    }
+    if (!cfg.verbose) {
+        fflush(stdout);
+        if (freopen("/dev/null", "w", stdout) == NULL) {
+            fprintf(stderr, "Cannot silence stdout\n");
+        }
+    }
+    export_fd = cfg.verbose ? STDOUT_FILENO : open("/dev/null", O_WRONLY);
+
+    init_timer();
+    rss_before = max_rss_kb();
+
+    start = now_sec();
+    for (i = 0; i < num_ops; i++) {
+        double op_start;
+
+        if (cfg.rate > 0) {
+            /* Latency counts from the scheduled start, so falling behind shows up */
+            scheduled = start + (double)i / cfg.rate;
+            op_start = now_sec();
+            if (op_start < scheduled) {
+                struct timespec ts;
+                double wait = scheduled - op_start;
+
+                ts.tv_sec = (time_t)wait;
+                ts.tv_nsec = (long)((wait - (double)ts.tv_sec) * 1e9);
+                nanosleep(&ts, NULL);
+            }
+            op_start = scheduled;
+        } else {
+            op_start = now_sec();
+        }
+
+        if (cfg.verbose) {
+            fflush(stdout);
+        }
+        run_op(&ops[i], export_fd, cfg.export_threads);
+        latencies[i] = now_sec() - op_start;
+        counts[ops[i].kind]++;
+    }
+    elapsed = now_sec() - start;
+
+    rss_after = max_rss_kb();
+    uninit_timer();
+    fflush(stdout);
+
+    qsort(latencies, (size_t)num_ops, sizeof(double), compare_double);
+
+    fprintf(report, "\n=== Timer Load Report ===\n");
+    fprintf(report, "Source:        %s\n", cfg.trace_in ? cfg.trace_in : "synthesized");
+    fprintf(report, "Operations:    %ld (add %ld, delete %ld, list %ld, export %ld, watchdog %ld, drain %ld)\n",
+            num_ops, counts[OP_ADD], counts[OP_DELETE], counts[OP_LIST],
+            counts[OP_EXPORT], counts[OP_WATCHDOG], counts[OP_DRAIN]);
+    fprintf(report, "Elapsed:       %.3f sec\n", elapsed);
+    fprintf(report, "Throughput:    %.0f ops/sec", elapsed > 0 ? (double)num_ops / elapsed : 0.0);
+    if (cfg.rate > 0) {
+        fprintf(report, " (target %.0f)", cfg.rate);
+    }
+    fprintf(report, "\n");
+    fprintf(report, "Latency (us):  p50 %.1f  p90 %.1f  p99 %.1f  p99.9 %.1f  max %.1f\n",
+            percentile(latencies, num_ops, 50) * 1e6,
+            percentile(latencies, num_ops, 90) * 1e6,
+            percentile(latencies, num_ops, 99) * 1e6,
+            percentile(latencies, num_ops, 99.9) * 1e6,
+            num_ops ? latencies[num_ops - 1] * 1e6 : 0.0);
+    fprintf(report, "Max RSS:       %ld KB -> %ld KB (+%ld KB)\n",
+            rss_before, rss_after, rss_after - rss_before);
+
+    if (export_fd != STDOUT_FILENO && export_fd >= 0) {
+        close(export_fd);
+    }
+    if (report != stderr) {
+        fclose(report);
+    }
+    free(latencies);
+    free(ops);
+    return 0;
+}
+
@@ -0,0 +1,102 @@
+
+/*
+ * Example client for the shared memory timer store.
+ * Prints the timers and watchdog status published by a running timer.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "consts.h"
+#include "timer_shm.h"
+
+/*
+ * Format record idx straight from the mapping into buf
+ * Returns: 0 on success, ERROR_CODE if the record no longer exists
+ *          or the store cannot be read
+ */
+static int format_shm_record(const struct timer_shm_view* view, unsigned idx, char* buf)
+{
+    char start[BUF_SIZE];
+    char end[BUF_SIZE];
+    const struct timer_shm_record* tr;
+    struct tm tm_tmp;
+    time_t t;
+    uint32_t seq;
+    int found;
+
+    do {
+        if (timer_shm_read_begin(view, &seq) == ERROR_CODE) {
+            return ERROR_CODE;
+        }
+        found = idx < timer_shm_count(view);
+        if (found) {
+            tr = &view->hdr->records[idx];
+            /* The segment is another process's data: print what cannot be converted as unknown */
+            t = (time_t)tr->starttime;
+            if (localtime_r(&t, &tm_tmp) == NULL ||
+                strftime(start, BUF_SIZE, "%I:%M %p", &tm_tmp) == 0) {
+                strcpy(start, "??:??");
+            }
+            t = (time_t)tr->endtime;
+            if (localtime_r(&t, &tm_tmp) == NULL ||
+                strftime(end, BUF_SIZE, "%I:%M %p", &tm_tmp) == 0) {
+                strcpy(end, "??:??");
+            }
+            sprintf(buf, "%u\t%s\t%s\t%u\n", idx + 1, start, end, tr->channel);
+        }
+    } while (timer_shm_read_retry(view, seq));
+
+    return found ? 0 : ERROR_CODE;
+}
+
+int main()
+{
+    struct timer_shm_view view;
+    char buf[3 * BUF_SIZE];
+    unsigned i, count;
+    int wd_enabled, wd_expired, wd_timeout;
+    long long wd_last_kick;
+    uint32_t seq;
+
+    if (timer_shm_attach(&view, TIMER_SHM_NAME) == ERROR_CODE) {
+        printf("No timer store published at %s\n", TIMER_SHM_NAME);
+        return 1;
+    }
+
+    do {
+        if (timer_shm_read_begin(&view, &seq) == ERROR_CODE) {
+            printf("Timer store at %s is not being updated\n", TIMER_SHM_NAME);
+            timer_shm_detach(&view);
+            return 1;
+        }
+        count = timer_shm_count(&view);
+        wd_enabled = view.hdr->watchdog_enabled;
+        wd_expired = view.hdr->watchdog_expired;
+        wd_timeout = view.hdr->watchdog_timeout;
+        wd_last_kick = (long long)view.hdr->watchdog_last_kick;
+    } while (timer_shm_read_retry(&view, seq));
+
+    printf("\n\nCurrent Set Timers");
+    printf("\nRecord#\tStart Time\tEnd Time\tChannel\n");
+    for (i = 0; i < count; i++) {
+        if (format_shm_record(&view, i, buf) == ERROR_CODE) {
+            break;
+        }
+        printf("%s", buf);
+    }
+
+    if (wd_enabled) {
+        printf("\nWatchdog: enabled%s, last kick %lld, timeout %d sec\n",
+               wd_expired ? " (EXPIRED)" : "", wd_last_kick, wd_timeout);
+    } else {
+        printf("\nWatchdog: disabled\n");
+    }
+
+    timer_shm_detach(&view);
+    return 0;
+}
+
@@ -4,6 +4,10 @@
  * Modified By Daniel Liezrowice 12/12/2025
  */
 
+#define _POSIX_C_SOURCE 200809L
+
+#include <locale.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -12,13 +16,132 @@
 #include "consts.h"
 #include "inout.h"
 #include "timer.h"
+#include "timer_internal.h"
+#include "timer_queue.h"
+#include "timer_shm.h"
 
 
-static struct timer_record* timer_records[BUF_SIZE];
-const int max_records = BUF_SIZE;
+static struct timer_record* timer_records[TIMER_CAPACITY];
+const int max_records = TIMER_CAPACITY;
 static int curr_index = 0;
 static struct timer_record* cached_record = NULL;  /* BUG #2: Used for use-after-free demo */
 
+/*
+ * Scratch for timer_batch_apply, kept off the stack since the store may
+ * be large; only used under the store lock. A batch that fits the store
+ * never adds or deletes more than TIMER_CAPACITY records.
+ */
+static struct timer_record* batch_adds_sorted[TIMER_CAPACITY];
+static char batch_doomed[TIMER_CAPACITY];
+static struct timer_record* batch_doomed_records[TIMER_CAPACITY];
+
+#ifdef TIMER_THREADSAFE
+pthread_mutex_t timer_store_mutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+/* Named after the policies this store was built with, see timer_config.h */
+const int TIMER_POLICY_SYMBOL = TIMER_CAPACITY;
+
+#ifdef TIMER_STATIC_POOL
+/*
+ * RECORD POOL
+ * Fixed storage for builds without a heap: room for a full store plus
+ * the pending adds of a batch replacing all of it. Free slots are kept
+ * on a stack.
+ */
+#define RECORD_POOL_SIZE (2 * TIMER_CAPACITY)
+
+static struct timer_record record_pool[RECORD_POOL_SIZE];
+static struct timer_record* record_free_list[RECORD_POOL_SIZE];
+static int record_free_count = -1;  /* -1 until init_timer fills the pool */
+
+/*
+ * Put every pool slot on the free list, once
+ */
+static void pool_init(void)
+{
+    int i;
+
+    if (record_free_count >= 0) {
+        return;
+    }
+    for (i = 0; i < RECORD_POOL_SIZE; i++) {
+        record_free_list[i] = &record_pool[RECORD_POOL_SIZE - 1 - i];
+    }
+    record_free_count = RECORD_POOL_SIZE;
+}
+
+/*
+ * Returns: 1 if tr is a pool slot that may go back on the free list
+ */
+static int pool_owns(const struct timer_record* tr)
+{
+    uintptr_t addr = (uintptr_t)tr;
+    uintptr_t base = (uintptr_t)record_pool;
+
+    return addr >= base &&
+           addr < base + sizeof(record_pool) &&
+           (addr - base) % sizeof(struct timer_record) == 0 &&
+           record_free_count >= 0 &&
+           record_free_count < RECORD_POOL_SIZE;
+}
+#endif
+
+static int apply_batch(struct timer_batch*);
+static void remove_record(int);
+static int pop_expired(time_t, struct timer_event*);
+
+/*
+ * Take a record from the heap or the pool; caller holds the store lock
+ */
+static struct timer_record* acquire_record(void)
+{
+#ifdef TIMER_STATIC_POOL
+    return (record_free_count > 0) ? record_free_list[--record_free_count] : NULL;
+#else
+    return (struct timer_record*)malloc(sizeof(struct timer_record));
+#endif
+}
+
+/*
+ * Give a record back to the heap or the pool; caller holds the store lock.
+ * In pool builds, pointers that did not come from the pool are ignored.
+ */
+static void release_record(struct timer_record* tr)
+{
+#ifdef TIMER_STATIC_POOL
+    if (tr != NULL && pool_owns(tr)) {
+        record_free_list[record_free_count++] = tr;
+    }
+#else
+    free(tr);
+#endif
+}
+
+/*
+ * Allocate a record for add_timer_record or a batch
+ * Returns: the record or NULL if none is available
+ */
+struct timer_record* timer_record_alloc(void)
+{
+    struct timer_record* tr;
+
+    TIMER_LOCK();
+    tr = acquire_record();
+    TIMER_UNLOCK();
+    return tr;
+}
+
+/*
+ * Free a record that was never handed to the store
+ */
+void timer_record_free(struct timer_record* tr)
+{
+    TIMER_LOCK();
+    release_record(tr);
+    TIMER_UNLOCK();
+}
+
 /*
  * WATCHDOG TIMER - 15-Dec-2025 Daniel Liezrowice
  * A simple software watchdog timer with 10 second expiration.
@@ -31,15 +154,154 @@ static time_t watchdog_last_kick = 0;
 static int watchdog_enabled = 0;
 static int watchdog_expired = 0;
 
+/*
+ * LIST RENDER CACHE
+ * Keeps the formatted line of every record so list_timers() only
+ * re-formats records inside the dirty range [render_dirty_lo, render_dirty_hi).
+ * Lines depend on the timezone and LC_TIME locale, so a change of either
+ * invalidates the whole cache.
+ */
+static char render_cache[TIMER_CAPACITY][BUF_SIZE];
+static int render_dirty_lo = 0;
+static int render_dirty_hi = TIMER_CAPACITY;
+static char render_tz[BUF_SIZE];
+static char render_locale[BUF_SIZE];
+
+/*
+ * Extend the dirty range to cover [lo, hi)
+ */
+static void render_mark_dirty(int lo, int hi)
+{
+    if (lo < render_dirty_lo) {
+        render_dirty_lo = lo;
+    }
+    if (hi > render_dirty_hi) {
+        render_dirty_hi = hi;
+    }
+}
+
+/*
+ * Invalidate the whole cache if the timezone or LC_TIME locale changed
+ * since the last listing
+ */
+static void render_check_environment(void)
+{
+    char tz[BUF_SIZE];
+    const char* env_tz;
+    const char* locale;
+
+    tzset();
+    env_tz = getenv("TZ");
+    snprintf(tz, sizeof(tz), "%s|%s|%s", env_tz ? env_tz : "", tzname[0], tzname[1]);
+    locale = setlocale(LC_TIME, NULL);
+    if (locale == NULL) {
+        locale = "";
+    }
+
+    if (strcmp(tz, render_tz) != 0 || strncmp(locale, render_locale, BUF_SIZE - 1) != 0) {
+        strcpy(render_tz, tz);
+        strncpy(render_locale, locale, BUF_SIZE - 1);
+        render_locale[BUF_SIZE - 1] = '\0';
+        timer_render_invalidate();
+    }
+}
+
+/*
+ * Force every line to be re-formatted on the next listing
+ * (needed if a caller modifies a stored record in place)
+ */
+void timer_render_invalidate(void)
+{
+    render_mark_dirty(0, TIMER_CAPACITY);
+}
+
+/*
+ * Mirror the store into the shared memory view, if one is open.
+ * Only slots from first on changed; earlier slots are not copied again.
+ */
+static void publish_store(int first)
+{
+    timer_shm_publish(timer_records, curr_index, first, watchdog_enabled, watchdog_expired,
+                      watchdog_last_kick, WATCHDOG_TIMEOUT_SEC);
+}
+
+/*
+ * TRACE RECORDING
+ * With TIMER_TRACE=<file> in the environment, init_timer() opens the file
+ * and every add, delete, list and export is appended to it in loadgen's
+ * trace format, so the load of a real timer process can be replayed with
+ * "loadgen -i <file>". A batch is written as its deletes, highest index
+ * first, followed by its adds. The file is flushed by uninit_timer().
+ */
+static FILE* trace_file = NULL;
+
+/*
+ * Start recording if TIMER_TRACE names a file
+ */
+static void trace_open(void)
+{
+    const char* name = getenv("TIMER_TRACE");
+
+    if (trace_file != NULL || name == NULL || name[0] == '\0') {
+        return;
+    }
+    trace_file = fopen(name, "w");
+    if (trace_file == NULL) {
+        print_string("Cannot open the TIMER_TRACE file ... not recording\n");
+    }
+}
+
+static void trace_close(void)
+{
+    if (trace_file != NULL) {
+        fclose(trace_file);
+        trace_file = NULL;
+    }
+}
+
+/*
+ * Record an add, caller holds the store lock
+ */
+static void trace_add(const struct timer_record* tr)
+{
+    if (trace_file != NULL) {
+        fprintf(trace_file, "A %lld %lld %u\n",
+                (long long)tr->starttime, (long long)tr->endtime, tr->channel);
+    }
+}
+
+/*
+ * Record a delete, caller holds the store lock
+ */
+static void trace_delete(int idx)
+{
+    if (trace_file != NULL) {
+        fprintf(trace_file, "D %d\n", idx);
+    }
+}
+
+/*
+ * Record an operation without arguments ('L', 'X'), caller holds the store lock
+ */
+void timer_trace_op(char code)
+{
+    if (trace_file != NULL) {
+        fprintf(trace_file, "%c\n", code);
+    }
+}
+
 /*
  * Initialize and start the watchdog timer
  */
 void watchdog_init(void)
 {
-    watchdog_last_kick = time(NULL);
+    TIMER_LOCK();
+    watchdog_last_kick = TIMER_CLOCK_NOW();
     watchdog_enabled = 1;
     watchdog_expired = 0;
     print_string("Watchdog timer initialized (10 second timeout)\n");
+    publish_store(curr_index);
+    TIMER_UNLOCK();
 }
 
 /*
@@ -48,10 +310,13 @@ void watchdog_init(void)
  */
 void watchdog_kick(void)
 {
+    TIMER_LOCK();
     if (watchdog_enabled) {
-        watchdog_last_kick = time(NULL);
+        watchdog_last_kick = TIMER_CLOCK_NOW();
         watchdog_expired = 0;
+        publish_store(curr_index);
     }
+    TIMER_UNLOCK();
 }
 
 /*
@@ -61,19 +326,21 @@ void watchdog_kick(void)
 int watchdog_check(void)
 {
     time_t now;
+    int expired = 0;
     
-    if (!watchdog_enabled) {
-        return 0;
-    }
-    
-    now = time(NULL);
-    if (difftime(now, watchdog_last_kick) >= WATCHDOG_TIMEOUT_SEC) {
-        watchdog_expired = 1;
-        print_string("WARNING: Watchdog timer expired!\n");
-        return 1;
+    TIMER_LOCK();
+    if (watchdog_enabled) {
+        now = TIMER_CLOCK_NOW();
+        if (difftime(now, watchdog_last_kick) >= WATCHDOG_TIMEOUT_SEC) {
+            watchdog_expired = 1;
+            publish_store(curr_index);
+            print_string("WARNING: Watchdog timer expired!\n");
+            expired = 1;
+        }
     }
+    TIMER_UNLOCK();
     
-    return 0;
+    return expired;
 }
 
 /*
@@ -81,9 +348,12 @@ int watchdog_check(void)
  */
 void watchdog_disable(void)
 {
+    TIMER_LOCK();
     watchdog_enabled = 0;
     watchdog_expired = 0;
     print_string("Watchdog timer disabled\n");
+    publish_store(curr_index);
+    TIMER_UNLOCK();
 }
 
 /*
@@ -92,7 +362,12 @@ void watchdog_disable(void)
  */
 int watchdog_is_enabled(void)
 {
-    return watchdog_enabled;
+    int enabled;
+
+    TIMER_LOCK();
+    enabled = watchdog_enabled;
+    TIMER_UNLOCK();
+    return enabled;
 }
 
 /*
@@ -103,24 +378,39 @@ int watchdog_time_remaining(void)
 {
     time_t now;
     double elapsed;
+    int remaining = 0;
     
-    if (!watchdog_enabled) {
-        return 0;
-    }
-    
-    now = time(NULL);
-    elapsed = difftime(now, watchdog_last_kick);
-    
-    if (elapsed >= WATCHDOG_TIMEOUT_SEC) {
-        return 0;
+    TIMER_LOCK();
+    if (watchdog_enabled) {
+        now = TIMER_CLOCK_NOW();
+        elapsed = difftime(now, watchdog_last_kick);
+        if (elapsed < WATCHDOG_TIMEOUT_SEC) {
+            remaining = (int)(WATCHDOG_TIMEOUT_SEC - elapsed);
+        }
     }
+    TIMER_UNLOCK();
     
-    return (int)(WATCHDOG_TIMEOUT_SEC - elapsed);
+    return remaining;
 }
 
-void init_timer()
+/*
+ * init_timer() expands to this, passing the policy symbol of the caller's
+ * build; referring to it is the check, so the value itself is unused
+ */
+void timer_init_policy(const int* policy)
 {
-    memset(timer_records, 0, sizeof(struct timer_record*) * BUF_SIZE); 
+    (void)policy;
+#ifdef TIMER_STATIC_POOL
+    TIMER_LOCK();
+    pool_init();
+    TIMER_UNLOCK();
+#endif
+    memset(timer_records, 0, sizeof(struct timer_record*) * TIMER_CAPACITY); 
+    tq_clear();
+    timer_render_invalidate();
+    TIMER_LOCK();
+    trace_open();
+    TIMER_UNLOCK();
 }
 
 /*
@@ -136,13 +426,26 @@ void uninit_timer()
     int i;
     int last_channel = -1;
     
+    /* Before taking the store lock, which an export holds while it waits for its workers */
+    timer_export_shutdown();
+
+    TIMER_LOCK();
     if (cached_record != NULL) {
         last_channel = (int)cached_record->channel;
     }
 
-    for (i = 0; i < max_records; i++) {
-        delete_timer_record(i);
+    /*
+     * Free every record in one pass. Deleting index by index shifted the
+     * tail on each call, costing O(n^2) and skipping records as they moved.
+     */
+    for (i = 0; i < curr_index; i++) {
+        release_record(timer_records[i]);
+        timer_records[i] = NULL;
     }
+    curr_index = 0;
+    tq_clear();
+    timer_render_invalidate();
+    publish_store(0);
     
     if (last_channel >= 0 && last_channel <= 9999) {
         print_string("Last cached channel was: ");
@@ -150,6 +453,8 @@ void uninit_timer()
     }
     
     cached_record = NULL;
+    trace_close();
+    TIMER_UNLOCK();
 }
 
 /*
@@ -169,7 +474,7 @@ struct timer_record* query_user()
     time_t timer;
     struct tm* tm_tmp;
 
-    timer = time(NULL);
+    timer = TIMER_CLOCK_NOW();
     tm_tmp = localtime(&timer);
     
     /*
@@ -180,7 +485,7 @@ struct timer_record* query_user()
      * Resolution: Added NULL check after malloc() and return NULL on allocation failure.
      * This prevents null pointer dereference and properly propagates allocation failures to caller.
      */
-    the_record = (struct timer_record*)malloc(sizeof(struct timer_record));
+    the_record = timer_record_alloc();
     if (the_record == NULL) {
         return NULL;
     }
@@ -267,11 +572,18 @@ void add_timer_record(struct timer_record* tr)
         _EB_SEND(buf)
     }
 #endif
+    TIMER_LOCK();
     if (curr_index < max_records) {
         timer_records[curr_index++] = tr;
+        trace_add(tr);
+        tq_push(tr->starttime, tr, 0);
+        tq_push(tr->endtime, tr, 1);
+        render_mark_dirty(curr_index - 1, curr_index);
+        publish_store(curr_index - 1);
     } else {
         print_string("\nAll timers used ... timer not added\n");
     }
+    TIMER_UNLOCK();
 }
 
 /*
@@ -302,6 +614,40 @@ void add_timer_record(struct timer_record* tr)
  *          Resolution: Removed tr_copy variable and the conditional double-free code entirely.
  */
 void delete_timer_record(int idx)
+{
+    if (!TIMER_VALID(idx >= 0 && idx < max_records)) {
+        return;
+    }
+    
+    TIMER_LOCK();
+    remove_record(idx);
+    TIMER_UNLOCK();
+}
+
+/*
+ * Delete the record at idx, validating idx against the current store
+ * under the same lock, whatever the TIMER_UNCHECKED policy.
+ * Use this for untrusted input such as a menu selection.
+ * Returns: 0 on success, ERROR_CODE if there is no record at idx
+ */
+int delete_timer_record_checked(int idx)
+{
+    int result = ERROR_CODE;
+
+    TIMER_LOCK();
+    if (idx >= 0 && idx < curr_index && timer_records[idx] != NULL) {
+        remove_record(idx);
+        result = 0;
+    }
+    TIMER_UNLOCK();
+    return result;
+}
+
+/*
+ * Body of delete_timer_record; caller holds the store lock
+ * and has checked that idx is within [0, max_records)
+ */
+static void remove_record(int idx)
 {
     struct timer_record* tr;
     int i;
@@ -314,19 +660,23 @@ void delete_timer_record(int idx)
      * because curr_index could be >= max_records, making i+1 >= 100.
      * Resolution: Added explicit bound calculation for loop_end to ensure i+1 never
      * exceeds max_records-1. This guarantees all array accesses are within bounds.
+     *
+     * FIX: 19-Oct-2026 agent
+     * Issue: Use-after-free - the clamp stopped one slot early on a full store
+     *        (loop_end = max_records-2), so the last record was never shifted down:
+     *        it leaked and the one before it was left in two slots, to be freed twice.
+     * Resolution: Clamp loop_end to max_records-1; i < max_records-1 already keeps
+     *        i+1 in bounds.
      */
-    if (idx < 0 || idx >= max_records) {
-        return;
-    }
-    
     tr = timer_records[idx];
-    if (tr == NULL) {
+    if (!TIMER_VALID(tr != NULL)) {
         return;
     }
+    trace_delete(idx);
     
     loop_end = curr_index - 1;
-    if (loop_end >= max_records - 1) {
-        loop_end = max_records - 2;
+    if (loop_end > max_records - 1) {
+        loop_end = max_records - 1;
     }
     
     for (i = idx; i < loop_end && i >= 0 && (i + 1) < max_records; i++)
@@ -334,12 +684,205 @@ void delete_timer_record(int idx)
         timer_records[i] = timer_records[i+1];
     }
     
+    tq_remove_records(&tr, 1);
+
+    /* Every record from idx on moved up and got a new number */
+    render_mark_dirty(idx, curr_index);
+
     if (curr_index > 0) {
         timer_records[curr_index - 1] = NULL;
         curr_index--;
     }
     
-    free(tr);
+    release_record(tr);
+    publish_store(idx);
+}
+
+/*
+ * Set up an empty batch collecting up to max_adds adds into adds[] and
+ * up to max_deletes deletes into deletes[]; either array may be NULL
+ * with a maximum of 0. The arrays must outlive the batch.
+ */
+void timer_batch_init(struct timer_batch* batch, struct timer_record** adds, int max_adds,
+                      int* deletes, int max_deletes)
+{
+    if (batch == NULL) {
+        return;
+    }
+    batch->adds = adds;
+    batch->num_adds = 0;
+    batch->max_adds = (adds != NULL && max_adds > 0) ? max_adds : 0;
+    batch->deletes = deletes;
+    batch->num_deletes = 0;
+    batch->max_deletes = (deletes != NULL && max_deletes > 0) ? max_deletes : 0;
+}
+
+/*
+ * Queue a record to be added when the batch is applied.
+ * The store takes ownership of the record only if the batch applies.
+ */
+int timer_batch_add(struct timer_batch* batch, struct timer_record* tr)
+{
+    if (batch == NULL || tr == NULL || batch->num_adds >= batch->max_adds) {
+        return ERROR_CODE;
+    }
+    batch->adds[batch->num_adds++] = tr;
+    return 0;
+}
+
+/*
+ * Queue the record at idx to be deleted when the batch is applied.
+ * idx refers to the position before the batch is applied.
+ */
+int timer_batch_delete(struct timer_batch* batch, int idx)
+{
+    if (batch == NULL || batch->num_deletes >= batch->max_deletes) {
+        return ERROR_CODE;
+    }
+    batch->deletes[batch->num_deletes++] = idx;
+    return 0;
+}
+
+/*
+ * Apply all queued adds and deletes, or none of them.
+ * Everything is validated first (indices in range, adds distinct and not
+ * already stored); the store is then compacted in a single
+ * O(n) pass, deleted records are freed and the adds appended.
+ * Returns ERROR_CODE (store untouched) if any operation is invalid or the
+ * result would not fit. On success the batch is emptied.
+ */
+int timer_batch_apply(struct timer_batch* batch)
+{
+    int result;
+
+    TIMER_LOCK();
+    result = apply_batch(batch);
+    TIMER_UNLOCK();
+    return result;
+}
+
+/*
+ * Orders record pointers for the duplicate-add check
+ */
+static int compare_record_ptrs(const void* a, const void* b)
+{
+    const struct timer_record* x = *(struct timer_record* const*)a;
+    const struct timer_record* y = *(struct timer_record* const*)b;
+
+    return (x > y) - (x < y);
+}
+
+/*
+ * Body of timer_batch_apply; caller holds the store lock
+ */
+static int apply_batch(struct timer_batch* batch)
+{
+    char* doomed = batch_doomed;
+    struct timer_record** doomed_records = batch_doomed_records;
+    int num_doomed = 0;
+    int first_doomed;
+    int old_index;
+    int i, j, k, idx;
+
+    if (batch == NULL || batch->num_adds < 0 || batch->num_deletes < 0) {
+        return ERROR_CODE;
+    }
+
+    /* Only the first curr_index flags are ever read */
+    memset(doomed, 0, (size_t)curr_index);
+    first_doomed = curr_index;
+
+    for (i = 0; i < batch->num_deletes; i++) {
+        idx = batch->deletes[i];
+        if (idx < 0 || idx >= curr_index || timer_records[idx] == NULL) {
+            return ERROR_CODE;
+        }
+        /* Duplicate deletes of the same index collapse into one */
+        if (!doomed[idx]) {
+            doomed[idx] = 1;
+            num_doomed++;
+            if (idx < first_doomed) {
+                first_doomed = idx;
+            }
+        }
+    }
+
+    /* This also keeps the adds within the TIMER_CAPACITY sized scratch */
+    if (curr_index - num_doomed + batch->num_adds > max_records) {
+        return ERROR_CODE;
+    }
+
+    /*
+     * Each add must be a distinct record the store does not hold yet,
+     * otherwise it would later be freed twice
+     */
+    for (i = 0; i < batch->num_adds; i++) {
+        if (batch->adds[i] == NULL) {
+            return ERROR_CODE;
+        }
+        batch_adds_sorted[i] = batch->adds[i];
+    }
+    qsort(batch_adds_sorted, (size_t)batch->num_adds, sizeof(struct timer_record*),
+          compare_record_ptrs);
+    for (i = 1; i < batch->num_adds; i++) {
+        if (batch_adds_sorted[i] == batch_adds_sorted[i - 1]) {
+            return ERROR_CODE;
+        }
+    }
+    for (i = 0; batch->num_adds > 0 && i < curr_index; i++) {
+        if (bsearch(&timer_records[i], batch_adds_sorted, (size_t)batch->num_adds,
+                    sizeof(struct timer_record*), compare_record_ptrs) != NULL) {
+            return ERROR_CODE;
+        }
+    }
+
+    /* Deleting from the highest index down replays as the same compaction */
+    for (i = curr_index - 1; trace_file != NULL && i >= 0; i--) {
+        if (doomed[i]) {
+            trace_delete(i);
+        }
+    }
+    for (i = 0; i < batch->num_adds; i++) {
+        trace_add(batch->adds[i]);
+    }
+
+    /* Single compaction pass, survivors keep their relative order */
+    old_index = curr_index;
+    for (i = 0, j = 0, k = 0; i < old_index; i++) {
+        if (doomed[i]) {
+            doomed_records[k++] = timer_records[i];
+        } else {
+            timer_records[j++] = timer_records[i];
+        }
+    }
+
+    /* Drop their pending events before the records are freed in bulk */
+    tq_remove_records(doomed_records, num_doomed);
+    for (i = 0; i < num_doomed; i++) {
+        if (doomed_records[i] == cached_record) {
+            cached_record = NULL;
+        }
+        release_record(doomed_records[i]);
+    }
+
+    for (i = 0; i < batch->num_adds; i++) {
+        timer_records[j] = batch->adds[i];
+        tq_push(timer_records[j]->starttime, timer_records[j], 0);
+        tq_push(timer_records[j]->endtime, timer_records[j], 1);
+        j++;
+    }
+
+    for (i = j; i < old_index; i++) {
+        timer_records[i] = NULL;
+    }
+    curr_index = j;
+
+    /* Records before the first delete kept their lines */
+    render_mark_dirty(first_doomed, (old_index > j) ? old_index : j);
+    publish_store(0);
+    batch->num_adds = 0;
+    batch->num_deletes = 0;
+    return 0;
 }
 
 /*
@@ -353,26 +896,164 @@ void delete_timer_record(int idx)
  *        Also added bounds checking for idx to prevent out-of-bounds array access.
  */
 void format_timer_record(int idx, char* buf)
+{
+    format_timer_record_r(idx, buf, BUF_SIZE);
+}
+
+/*
+ * Reentrant version of format_timer_record
+ * Returns: length of the line written to buf, or 0 if there is no record
+ *          or its times cannot be converted to local time
+ */
+int format_timer_record_r(int idx, char* buf, size_t size)
+{
+    int len;
+
+    TIMER_LOCK();
+    len = timer_format_unlocked(idx, buf, size);
+    TIMER_UNLOCK();
+    return len;
+}
+
+/*
+ * Body of format_timer_record_r; caller holds the store lock. Safe to call
+ * from several threads at once as long as the store is not modified meanwhile.
+ */
+int timer_format_unlocked(int idx, char* buf, size_t size)
 {
     char start[BUF_SIZE];
     char end[BUF_SIZE];
     struct timer_record* tr;
+    struct tm tm_tmp;
+    int len;
     
     /* Validate idx bounds and buf pointer */
-    if (idx < 0 || idx >= max_records || buf == NULL) {
-        return;
+    if (!TIMER_VALID(idx >= 0 && idx < max_records && buf != NULL && size > 0)) {
+        return 0;
     }
     
     tr = timer_records[idx];
     
     /* Check tr BEFORE dereferencing to avoid null pointer access */
-    if (tr == NULL) {
-        return;
+    if (!TIMER_VALID(tr != NULL)) {
+        return 0;
+    }
+
+    /* Times the C library cannot convert give no line rather than a crash */
+    if (localtime_r(&tr->starttime, &tm_tmp) == NULL) {
+        buf[0] = '\0';
+        return 0;
+    }
+    strftime(start, BUF_SIZE, "%I:%M %p", &tm_tmp);
+    if (localtime_r(&tr->endtime, &tm_tmp) == NULL) {
+        buf[0] = '\0';
+        return 0;
+    }
+    strftime(end, BUF_SIZE, "%I:%M %p", &tm_tmp);
+    len = snprintf(buf, size, "%d\t%s\t%s\t%d\n", idx+1, start, end, tr->channel);
+    if (len < 0) {
+        buf[0] = '\0';
+        return 0;
+    }
+    return ((size_t)len < size) ? len : (int)(size - 1);
+}
+
+/*
+ * Deadline of the earliest pending start/end event
+ * Returns: 0 and sets *when, or ERROR_CODE if no event is pending
+ */
+int timer_next_due(time_t* when)
+{
+    const struct timer_event* ev;
+    int result = ERROR_CODE;
+
+    TIMER_LOCK();
+    ev = tq_peek();
+    if (ev != NULL && when != NULL) {
+        *when = ev->deadline;
+        result = 0;
+    }
+    TIMER_UNLOCK();
+    return result;
+}
+
+/*
+ * Pop the earliest event if it is due at or before now
+ * Returns: 1 if an event was popped into *ev, 0 otherwise
+ */
+int timer_pop_expired(time_t now, struct timer_event* ev)
+{
+    int popped;
+
+    TIMER_LOCK();
+    popped = pop_expired(now, ev);
+    TIMER_UNLOCK();
+    return popped;
+}
+
+/*
+ * Body of timer_pop_expired; caller holds the store lock
+ */
+static int pop_expired(time_t now, struct timer_event* ev)
+{
+    const struct timer_event* top = tq_peek();
+
+    if (top == NULL || top->deadline > now) {
+        return 0;
     }
+    return tq_pop(ev);
+}
+
+/*
+ * Pop up to n events due at or before now, earliest first
+ * Returns: number of events stored in out
+ */
+int timer_drain_expired(time_t now, struct timer_event out[], int n)
+{
+    int count = 0;
 
-    strftime(start, BUF_SIZE, "%I:%M %p", localtime(&tr->starttime));
-    strftime(end, BUF_SIZE, "%I:%M %p", localtime(&tr->endtime));
-    sprintf(buf, "%d\t%s\t%s\t%d\n", idx+1, start, end, tr->channel);
+    if (out == NULL) {
+        return 0;
+    }
+    TIMER_LOCK();
+    while (count < n && pop_expired(now, &out[count])) {
+        count++;
+    }
+    TIMER_UNLOCK();
+    return count;
+}
+
+/*
+ * Number of records currently stored
+ */
+int timer_count(void)
+{
+    int count;
+
+    TIMER_LOCK();
+    count = curr_index;
+    TIMER_UNLOCK();
+    return count;
+}
+
+/*
+ * Same as timer_count, for callers that already hold the store lock
+ */
+int timer_count_unlocked(void)
+{
+    return curr_index;
+}
+
+/*
+ * Record at idx, for callers that already hold the store lock
+ * Returns: the record, or NULL if idx holds none
+ */
+const struct timer_record* timer_record_unlocked(int idx)
+{
+    if (!TIMER_VALID(idx >= 0 && idx < curr_index)) {
+        return NULL;
+    }
+    return timer_records[idx];
 }
 
 /*
@@ -382,24 +1063,36 @@ void format_timer_record(int idx, char* buf)
  * buf remained uninitialized and was passed to print_string(), causing undefined behavior.
  * Resolution: Initialize buf to empty string before the loop. Also added check to only
  * print buf if it contains data (buf[0] != '\0') after format_timer_record returns.
+ *
+ * Lines now come from the render cache; only the dirty range is re-formatted.
  */
 void list_timers()
 {
-    char buf[BUF_SIZE];
     int i;
+    int hi;
     
-    buf[0] = '\0';
+    TIMER_LOCK();
+    timer_trace_op('L');
+    render_check_environment();
+
+    hi = (render_dirty_hi < curr_index) ? render_dirty_hi : curr_index;
+    for (i = render_dirty_lo; i < hi; i++)
+    {
+        render_cache[i][0] = '\0';
+        timer_format_unlocked(i, render_cache[i], BUF_SIZE);
+    }
+    render_dirty_lo = TIMER_CAPACITY;
+    render_dirty_hi = 0;
     
     print_string("\n\nCurrent Set Timers");
     print_string("\nRecord#\tStart Time\tEnd Time\tChannel\n");
     for (i = 0; i < curr_index; i++)
     {
-        buf[0] = '\0';
-        format_timer_record(i, buf);
-        if (buf[0] != '\0') {
-            print_string(buf);
+        if (render_cache[i][0] != '\0') {
+            print_string(render_cache[i]);
         }
     }
     print_string("\n\n");
+    TIMER_UNLOCK();
 }
 
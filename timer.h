@@ -2,7 +2,14 @@
 #ifndef _timer_h_
 #define _timer_h_
 
+#include <stddef.h>
 #include <time.h>
+#include "consts.h"
+#include "timer_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
 
 
 /* timere structure */
@@ -11,10 +18,21 @@ struct timer_record
     time_t starttime;
     time_t endtime;
     unsigned channel;
+    int queue_slot[2];      /* maintained by the store: expiry queue slots of the start/end events */
 };
 
+/*
+ * allocates/frees a record, from the heap or the static pool (TIMER_STATIC_POOL)
+ * pool builds: records handed to add_timer_record or a batch must come from
+ * timer_record_alloc, and init_timer must run first
+ */
+struct timer_record* timer_record_alloc(void);
+void timer_record_free(struct timer_record*);
+
 /* init/uninit routines for the timer */
-void init_timer();
+extern const int TIMER_POLICY_SYMBOL;       /* see timer_config.h */
+void timer_init_policy(const int*);
+#define init_timer() timer_init_policy(&TIMER_POLICY_SYMBOL)
 void uninit_timer();
 
 /* adds a timer, queries user for info, return ERROR_CODE on failure */
@@ -26,12 +44,72 @@ void add_timer_record(struct timer_record*);
 /* delete a timer */
 void delete_timer_record(int);
 
+/* delete a timer, validating the index under the store lock; ERROR_CODE if none */
+int delete_timer_record_checked(int);
+
 /* get string for a single timer */
 void format_timer_record(int, char*);
 
+/* reentrant version, returns length written (0 if no record) */
+int format_timer_record_r(int, char*, size_t);
+
+/* number of records currently stored */
+int timer_count(void);
+
 /* display list of all timers */
 void list_timers();
 
+/* force list_timers to re-format every record on its next call */
+void timer_render_invalidate(void);
+
+/*
+ * writes the same listing to a file descriptor, formatting the records
+ * in parallel on up to the given number of threads (see timer_export.c)
+ * returns ERROR_CODE on failure
+ */
+int export_timers(int fd, int nthreads);
+
+/*
+ * BATCH TRANSACTIONS
+ * Collects a set of adds and deletes and applies them all at once.
+ * Every operation is validated before anything is changed, deleted
+ * records are compacted out in a single pass and freed together.
+ * The caller provides the arrays the batch collects into, so a single
+ * batch can cover any number of records, e.g. cancelling a whole store.
+ */
+struct timer_batch
+{
+    struct timer_record** adds;
+    int num_adds;
+    int max_adds;
+    int* deletes;
+    int num_deletes;
+    int max_deletes;
+};
+
+void timer_batch_init(struct timer_batch*, struct timer_record** adds, int max_adds,
+                      int* deletes, int max_deletes);           /* Collect into the given arrays, empty */
+int  timer_batch_add(struct timer_batch*, struct timer_record*); /* Queue an add, ERROR_CODE if full */
+int  timer_batch_delete(struct timer_batch*, int);              /* Queue a delete, ERROR_CODE if full */
+int  timer_batch_apply(struct timer_batch*);                    /* Apply all or nothing, ERROR_CODE on failure */
+
+/*
+ * EXPIRY QUEUE
+ * Every stored timer has a start and an end event, kept in a min-heap
+ * ordered by deadline so callers can sleep until the next one is due.
+ * record points into the store and stays valid until the timer is deleted.
+ */
+struct timer_event
+{
+    time_t deadline;
+    struct timer_record* record;
+    int is_end;                     /* 0 = start event, 1 = end event */
+};
+
+int timer_next_due(time_t*);                                 /* O(1), ERROR_CODE if nothing is pending */
+int timer_pop_expired(time_t, struct timer_event*);          /* O(log n), 1 if an event due by then was popped */
+int timer_drain_expired(time_t, struct timer_event[], int);  /* Pop up to n due events, returns how many */
+
 /*
  * WATCHDOG TIMER API - 15-Dec-2025 Daniel Liezrowice
  * Software watchdog with 10 second expiration timeout
@@ -43,5 +121,9 @@ void watchdog_disable(void);        /* Disable the watchdog */
 int  watchdog_is_enabled(void);     /* Check if watchdog is enabled */
 int  watchdog_time_remaining(void); /* Get seconds until expiration */
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif /* _timer_h_ */
 
@@ -0,0 +1,69 @@
+
+#ifndef _timer_config_h_
+#define _timer_config_h_
+
+/*
+ * COMPILE-TIME STORE POLICIES
+ * Each deployment picks its store with -D flags (see CMakeLists.txt).
+ * Features that are not selected compile to nothing, so e.g. an embedded
+ * single-threaded pool build stores records without locking or malloc.
+ * export_timers() is separate: it always runs on pthreads and allocates
+ * its formatting arenas on the heap, so such builds should not call it.
+ *
+ * TIMER_CAPACITY     number of timer records, independent of BUF_SIZE (default 100),
+ *                    a plain decimal number
+ * TIMER_UNCHECKED    drop the index/NULL checks in delete_timer_record and
+ *                    format_timer_record; callers must pass valid arguments
+ * TIMER_THREADSAFE   serialize access to the store with a mutex
+ * TIMER_STATIC_POOL  take records from a fixed pool instead of malloc/free
+ * TIMER_CLOCK_NOW()  time source for the store and watchdog (default time(NULL))
+ */
+
+#ifndef TIMER_CAPACITY
+#define TIMER_CAPACITY 100
+#endif
+
+/* bounds policy: TIMER_VALID(cond) is the check, or constant true when unchecked */
+#ifdef TIMER_UNCHECKED
+#define TIMER_VALID(cond) 1
+#else
+#define TIMER_VALID(cond) (cond)
+#endif
+
+/* clock policy */
+#ifndef TIMER_CLOCK_NOW
+#define TIMER_CLOCK_NOW() time(NULL)
+#endif
+
+/*
+ * Programs must be built with the same policies as the store they link.
+ * The store defines a symbol named after its policies and init_timer()
+ * refers to it, so a mismatch fails to link instead of misbehaving.
+ */
+#ifdef TIMER_UNCHECKED
+#define TIMER_POLICY_CHECKS unchecked
+#else
+#define TIMER_POLICY_CHECKS checked
+#endif
+
+#ifdef TIMER_THREADSAFE
+#define TIMER_POLICY_THREADS threadsafe
+#else
+#define TIMER_POLICY_THREADS single
+#endif
+
+#ifdef TIMER_STATIC_POOL
+#define TIMER_POLICY_STORAGE pool
+#else
+#define TIMER_POLICY_STORAGE malloc
+#endif
+
+#define TIMER_POLICY_PASTE(cap, checks, threads, storage) \
+    timer_policy_##cap##_##checks##_##threads##_##storage
+#define TIMER_POLICY_NAME(cap, checks, threads, storage) \
+    TIMER_POLICY_PASTE(cap, checks, threads, storage)
+#define TIMER_POLICY_SYMBOL \
+    TIMER_POLICY_NAME(TIMER_CAPACITY, TIMER_POLICY_CHECKS, TIMER_POLICY_THREADS, TIMER_POLICY_STORAGE)
+
+#endif /* _timer_config_h_ */
+
@@ -0,0 +1,458 @@
+/*
+ * Parallel export of the timer list.
+ * The record range is split into one chunk per worker thread, each worker
+ * formats its chunk into its own arena, and the arenas are written out in
+ * order with a single writev() so the formatted text is never copied again.
+ *
+ * The workers and their arenas persist between exports. Workers do not
+ * call localtime_r for every line (glibc serializes it on one global
+ * lock); they convert times with a UTC offset looked up once per quarter
+ * hour of time covered, which is exact as long as the timezone only
+ * changes offset on a quarter hour, as every current zone does.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "consts.h"
+#include "timer.h"
+#include "timer_internal.h"
+
+#define EXPORT_MAX_THREADS 64
+#define AMPM_MAX           16    /* longest AM/PM string kept from the locale */
+#define OFFSET_BUCKET      900   /* seconds sharing one cached UTC offset */
+#define OFFSET_CACHE_SIZE  256   /* buckets remembered, a little over two and a half days */
+
+static char export_header[] = "\n\nCurrent Set Timers\nRecord#\tStart Time\tEnd Time\tChannel\n";
+static char export_footer[] = "\n\n";
+
+/* what every worker needs to format a line, set up once per export */
+struct export_clock
+{
+    char ampm[2][AMPM_MAX];     /* the locale's %p before and after noon */
+    size_t line_max;            /* longest possible line */
+};
+
+/* one worker's share of the records */
+struct export_chunk
+{
+    int first;      /* first record index */
+    int last;       /* one past the last record index */
+    char* arena;    /* formatted lines for [first, last) */
+    size_t size;    /* bytes allocated for arena, kept between exports */
+    size_t len;
+};
+
+/* UTC offset of one OFFSET_BUCKET of time */
+struct offset_entry
+{
+    long long bucket;
+    long offset;
+    int valid;      /* 0 if localtime_r could not convert it */
+};
+
+/*
+ * WORKER POOL
+ * Worker i formats chunks[i]; chunk 0 is formatted by the exporting thread.
+ * A new export bumps pool_generation, and each worker with a chunk
+ * decrements pool_pending when done. export_mutex serializes exports.
+ */
+static pthread_mutex_t export_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_work = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t pool_done = PTHREAD_COND_INITIALIZER;
+static pthread_t pool_threads[EXPORT_MAX_THREADS];
+static unsigned long pool_seen[EXPORT_MAX_THREADS];
+static int pool_size = 0;          /* workers started, they own chunks 1..pool_size */
+static int pool_stop = 0;
+static unsigned long pool_generation = 0;
+static int pool_chunks = 0;        /* chunks of the current export */
+static int pool_pending = 0;
+
+static struct export_chunk chunks[EXPORT_MAX_THREADS];
+static struct export_clock export_clock;
+
+/*
+ * Days from 1970-01-01 to the given civil date (proleptic Gregorian)
+ */
+static long long days_from_civil(long long y, int m, int d)
+{
+    long long era;
+    int yoe, doy, doe;
+
+    y -= (m <= 2);
+    era = (y >= 0 ? y : y - 399) / 400;
+    yoe = (int)(y - era * 400);
+    doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+/*
+ * Minute of the local day t falls in, from the bucket's cached offset
+ * Returns: 0 on success, ERROR_CODE if t cannot be converted
+ */
+static int local_minute(time_t t, struct offset_entry* cache, int* minute)
+{
+    long long secs = (long long)t;
+    long long bucket = secs / OFFSET_BUCKET - (secs % OFFSET_BUCKET < 0);
+    struct offset_entry* entry = &cache[(unsigned long long)bucket % OFFSET_CACHE_SIZE];
+    long long local;
+    struct tm tm_tmp;
+
+    if (!entry->valid || entry->bucket != bucket) {
+        entry->bucket = bucket;
+        entry->valid = (localtime_r(&t, &tm_tmp) != NULL);
+        if (entry->valid) {
+            local = days_from_civil(tm_tmp.tm_year + 1900LL, tm_tmp.tm_mon + 1, tm_tmp.tm_mday) * 86400 +
+                    tm_tmp.tm_hour * 3600 + tm_tmp.tm_min * 60 + tm_tmp.tm_sec;
+            entry->offset = (long)(local - secs);
+        }
+    }
+    if (!entry->valid) {
+        return ERROR_CODE;
+    }
+
+    local = (secs + entry->offset) % 86400;
+    if (local < 0) {
+        local += 86400;
+    }
+    *minute = (int)(local / 60);
+    return 0;
+}
+
+/*
+ * Append the decimal digits of v
+ * Returns: the end of what was written
+ */
+static char* put_int(char* out, long long v)
+{
+    char digits[24];
+    unsigned long long u = (v < 0) ? 0ULL - (unsigned long long)v : (unsigned long long)v;
+    int n = 0;
+
+    if (v < 0) {
+        *out++ = '-';
+    }
+    do {
+        digits[n++] = (char)('0' + u % 10);
+        u /= 10;
+    } while (u > 0);
+    while (n > 0) {
+        *out++ = digits[--n];
+    }
+    return out;
+}
+
+/*
+ * Append a minute of the day as strftime's "%I:%M %p" would
+ * Returns: the end of what was written
+ */
+static char* put_time(char* out, int minute)
+{
+    int hour = (minute / 60 + 11) % 12 + 1;
+    const char* ampm = export_clock.ampm[minute >= 12 * 60];
+
+    *out++ = (char)('0' + hour / 10);
+    *out++ = (char)('0' + hour % 10);
+    *out++ = ':';
+    *out++ = (char)('0' + minute % 60 / 10);
+    *out++ = (char)('0' + minute % 10);
+    *out++ = ' ';
+    while (*ampm != '\0') {
+        *out++ = *ampm++;
+    }
+    return out;
+}
+
+/*
+ * Format one record the way format_timer_record_r does, without going
+ * through printf: "%d\t%I:%M %p\t%I:%M %p\t%d\n"
+ * Returns: length written, 0 if the record is missing or its times cannot be converted
+ */
+static size_t format_line(char* out, int idx, struct offset_entry* cache)
+{
+    const struct timer_record* tr = timer_record_unlocked(idx);
+    char* end = out;
+    int start_minute, end_minute;
+
+    if (tr == NULL ||
+        local_minute(tr->starttime, cache, &start_minute) == ERROR_CODE ||
+        local_minute(tr->endtime, cache, &end_minute) == ERROR_CODE) {
+        return 0;
+    }
+
+    end = put_int(end, idx + 1LL);
+    *end++ = '\t';
+    end = put_time(end, start_minute);
+    *end++ = '\t';
+    end = put_time(end, end_minute);
+    *end++ = '\t';
+    end = put_int(end, (int)tr->channel);
+    *end++ = '\n';
+    return (size_t)(end - out);
+}
+
+/*
+ * Format every record of a chunk into its arena
+ * Each line is at most line_max characters, so the arena never overflows
+ */
+static void format_chunk(struct export_chunk* chunk)
+{
+    struct offset_entry cache[OFFSET_CACHE_SIZE];
+    int i;
+
+    memset(cache, 0, sizeof(cache));
+    chunk->len = 0;
+    for (i = chunk->first; i < chunk->last; i++) {
+        chunk->len += format_line(chunk->arena + chunk->len, i, cache);
+    }
+}
+
+/*
+ * Body of pool worker i: format chunks[i] of every export that has one
+ */
+static void* pool_worker(void* arg)
+{
+    int i = (int)(intptr_t)arg;
+
+    pthread_mutex_lock(&pool_mutex);
+    for (;;) {
+        while (!pool_stop && pool_seen[i] == pool_generation) {
+            pthread_cond_wait(&pool_work, &pool_mutex);
+        }
+        if (pool_stop) {
+            break;
+        }
+        pool_seen[i] = pool_generation;
+        if (i < pool_chunks) {
+            pthread_mutex_unlock(&pool_mutex);
+            format_chunk(&chunks[i]);
+            pthread_mutex_lock(&pool_mutex);
+            if (--pool_pending == 0) {
+                pthread_cond_signal(&pool_done);
+            }
+        }
+    }
+    pthread_mutex_unlock(&pool_mutex);
+    return NULL;
+}
+
+/*
+ * Start workers until chunks 1..n-1 all have one; caller holds pool_mutex
+ * Returns: the number of workers running, may fall short if threads cannot start
+ */
+static int pool_grow(int n)
+{
+    while (pool_size + 1 < n) {
+        pool_seen[pool_size + 1] = pool_generation;
+        if (pthread_create(&pool_threads[pool_size + 1], NULL, pool_worker,
+                           (void*)(intptr_t)(pool_size + 1)) != 0) {
+            break;
+        }
+        pool_size++;
+    }
+    return pool_size;
+}
+
+/*
+ * Stop the workers and free the arenas (called by uninit_timer)
+ */
+void timer_export_shutdown(void)
+{
+    int i;
+
+    pthread_mutex_lock(&export_mutex);
+    pthread_mutex_lock(&pool_mutex);
+    pool_stop = 1;
+    pthread_cond_broadcast(&pool_work);
+    pthread_mutex_unlock(&pool_mutex);
+
+    for (i = 1; i <= pool_size; i++) {
+        pthread_join(pool_threads[i], NULL);
+    }
+
+    pthread_mutex_lock(&pool_mutex);
+    pool_size = 0;
+    pool_stop = 0;
+    pthread_mutex_unlock(&pool_mutex);
+
+    for (i = 0; i < EXPORT_MAX_THREADS; i++) {
+        free(chunks[i].arena);
+        chunks[i].arena = NULL;
+        chunks[i].size = 0;
+    }
+    pthread_mutex_unlock(&export_mutex);
+}
+
+/*
+ * Pick up the timezone and the locale's AM/PM strings for this export
+ */
+static void export_clock_init(struct export_clock* clk)
+{
+    struct tm tm_tmp;
+    size_t ampm;
+    int i;
+
+    tzset();
+    memset(&tm_tmp, 0, sizeof(tm_tmp));
+    for (i = 0; i < 2; i++) {
+        tm_tmp.tm_hour = 12 * i;
+        if (strftime(clk->ampm[i], AMPM_MAX, "%p", &tm_tmp) == 0) {
+            clk->ampm[i][0] = '\0';
+        }
+    }
+
+    /* index and channel of up to 11 characters, two "hh:mm <ampm>" times, three tabs, newline */
+    ampm = strlen(clk->ampm[0]);
+    if (strlen(clk->ampm[1]) > ampm) {
+        ampm = strlen(clk->ampm[1]);
+    }
+    clk->line_max = 11 + 3 + 2 * (6 + ampm) + 11 + 1;
+}
+
+/*
+ * Make sure a chunk's arena can hold its lines
+ * Returns: 0 on success, ERROR_CODE if out of memory
+ */
+static int reserve_arena(struct export_chunk* chunk)
+{
+    size_t need = (size_t)(chunk->last - chunk->first) * export_clock.line_max;
+    char* grown;
+
+    if (need <= chunk->size) {
+        return 0;
+    }
+    grown = (char*)realloc(chunk->arena, need);
+    if (grown == NULL) {
+        return ERROR_CODE;
+    }
+    chunk->arena = grown;
+    chunk->size = need;
+    return 0;
+}
+
+/*
+ * Write all iovecs, continuing after partial writes
+ * Returns: 0 on success, ERROR_CODE on failure
+ */
+static int write_all(int fd, struct iovec* iov, int iovcnt)
+{
+    ssize_t written;
+
+    while (iovcnt > 0) {
+        written = writev(fd, iov, iovcnt);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return ERROR_CODE;
+        }
+
+        while (iovcnt > 0 && (size_t)written >= iov->iov_len) {
+            written -= (ssize_t)iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (char*)iov->iov_base + written;
+            iov->iov_len -= (size_t)written;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Write the timer listing to fd, formatting on up to nthreads threads.
+ * The store must not be modified until the call returns (with
+ * TIMER_THREADSAFE the store lock is held while formatting).
+ * Returns: 0 on success, ERROR_CODE on failure
+ */
+int export_timers(int fd, int nthreads)
+{
+    struct iovec iov[EXPORT_MAX_THREADS + 2];
+    int count;
+    int nchunks, per_chunk, extra, workers;
+    int i, first, iovcnt;
+    int result = 0;
+
+    if (fd < 0) {
+        return ERROR_CODE;
+    }
+
+    pthread_mutex_lock(&export_mutex);
+    TIMER_LOCK();
+    timer_trace_op('X');
+    count = timer_count_unlocked();
+    export_clock_init(&export_clock);
+
+    if (nthreads < 1) {
+        nthreads = 1;
+    } else if (nthreads > EXPORT_MAX_THREADS) {
+        nthreads = EXPORT_MAX_THREADS;
+    }
+    nchunks = (count < nthreads) ? count : nthreads;
+
+    /* Split [0, count) into nchunks nearly equal, contiguous ranges */
+    per_chunk = (nchunks > 0) ? count / nchunks : 0;
+    extra = (nchunks > 0) ? count % nchunks : 0;
+    for (i = 0, first = 0; i < nchunks; i++) {
+        chunks[i].first = first;
+        chunks[i].last = first + per_chunk + (i < extra ? 1 : 0);
+        chunks[i].len = 0;
+        if (reserve_arena(&chunks[i]) == ERROR_CODE) {
+            result = ERROR_CODE;
+        }
+        first = chunks[i].last;
+    }
+
+    if (result == 0 && nchunks > 0) {
+        /* Chunks without a worker, if threads could not start, are formatted here */
+        pthread_mutex_lock(&pool_mutex);
+        workers = pool_grow(nchunks);
+        pool_chunks = nchunks;
+        pool_pending = (nchunks - 1 < workers) ? nchunks - 1 : workers;
+        pool_generation++;
+        pthread_cond_broadcast(&pool_work);
+        pthread_mutex_unlock(&pool_mutex);
+
+        format_chunk(&chunks[0]);
+        for (i = workers + 1; i < nchunks; i++) {
+            format_chunk(&chunks[i]);
+        }
+
+        pthread_mutex_lock(&pool_mutex);
+        while (pool_pending > 0) {
+            pthread_cond_wait(&pool_done, &pool_mutex);
+        }
+        pthread_mutex_unlock(&pool_mutex);
+    }
+    TIMER_UNLOCK();
+
+    if (result == 0) {
+        /* Stitch header, chunks and footer together in order */
+        iovcnt = 0;
+        iov[iovcnt].iov_base = export_header;
+        iov[iovcnt++].iov_len = strlen(export_header);
+        for (i = 0; i < nchunks; i++) {
+            if (chunks[i].len > 0) {
+                iov[iovcnt].iov_base = chunks[i].arena;
+                iov[iovcnt++].iov_len = chunks[i].len;
+            }
+        }
+        iov[iovcnt].iov_base = export_footer;
+        iov[iovcnt++].iov_len = strlen(export_footer);
+
+        result = write_all(fd, iov, iovcnt);
+    }
+    pthread_mutex_unlock(&export_mutex);
+    return result;
+}
@@ -0,0 +1,34 @@
+
+#ifndef _timer_internal_h_
+#define _timer_internal_h_
+
+#include <stddef.h>
+#include "timer.h"
+
+/*
+ * Store internals shared by timer.c and timer_export.c.
+ * Not installed with timer.h: the lock discipline is not part of the API.
+ */
+
+/* threading policy */
+#ifdef TIMER_THREADSAFE
+#include <pthread.h>
+extern pthread_mutex_t timer_store_mutex;
+#define TIMER_LOCK()   pthread_mutex_lock(&timer_store_mutex)
+#define TIMER_UNLOCK() pthread_mutex_unlock(&timer_store_mutex)
+#else
+#define TIMER_LOCK()   ((void)0)
+#define TIMER_UNLOCK() ((void)0)
+#endif
+
+/* the callers hold TIMER_LOCK() */
+int timer_count_unlocked(void);                                  /* Number of records stored */
+const struct timer_record* timer_record_unlocked(int);           /* Record at an index, NULL if none */
+int timer_format_unlocked(int, char*, size_t);                   /* Body of format_timer_record_r */
+
+void timer_trace_op(char);                                       /* Record 'L' or 'X' with TIMER_TRACE */
+
+/* parallel export, see timer_export.c */
+void timer_export_shutdown(void);                                /* Stop the export workers */
+
+#endif /* _timer_internal_h_ */
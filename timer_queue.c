@@ -0,0 +1,225 @@
+
+/*
+ * Expiry queue: 4-ary implicit min-heap of timer start/end events ordered
+ * by deadline. A 4-ary heap is half as deep as a binary one and its
+ * children sit next to each other in memory, so sift-down touches fewer
+ * cache lines.
+ *
+ * The heap is indexed: every record keeps the slots of its two events in
+ * queue_slot[], updated whenever an event moves, so a single record is
+ * removed with two O(log n) sifts instead of a scan of the whole heap.
+ */
+
+#include "consts.h"
+#include "timer.h"
+#include "timer_queue.h"
+
+#define HEAP_ARITY    4
+#define HEAP_CAPACITY (2 * TIMER_CAPACITY)   /* a start and an end event per record */
+
+/*
+ * Removing more than 1/REBUILD_RATIO of the heap at once is cheaper as one
+ * filtering pass and a bottom-up rebuild than as one removal per event
+ */
+#define REBUILD_RATIO 16
+
+static struct timer_event heap[HEAP_CAPACITY];
+static int heap_size = 0;
+
+/*
+ * Store ev in slot i and tell its record where it went
+ */
+static void place(int i, struct timer_event ev)
+{
+    heap[i] = ev;
+    ev.record->queue_slot[ev.is_end] = i;
+}
+
+/*
+ * Returns: the slot ev ended up in
+ */
+static int sift_up(int i)
+{
+    struct timer_event ev = heap[i];
+    int parent;
+
+    while (i > 0) {
+        parent = (i - 1) / HEAP_ARITY;
+        if (heap[parent].deadline <= ev.deadline) {
+            break;
+        }
+        place(i, heap[parent]);
+        i = parent;
+    }
+    place(i, ev);
+    return i;
+}
+
+static void sift_down(int i)
+{
+    struct timer_event ev = heap[i];
+    int child, last, smallest;
+
+    for (;;) {
+        child = HEAP_ARITY * i + 1;
+        if (child >= heap_size) {
+            break;
+        }
+
+        last = child + HEAP_ARITY;
+        if (last > heap_size) {
+            last = heap_size;
+        }
+        for (smallest = child++; child < last; child++) {
+            if (heap[child].deadline < heap[smallest].deadline) {
+                smallest = child;
+            }
+        }
+
+        if (ev.deadline <= heap[smallest].deadline) {
+            break;
+        }
+        place(i, heap[smallest]);
+        i = smallest;
+    }
+    place(i, ev);
+}
+
+/*
+ * Take the event in slot i out of the heap, O(log n)
+ */
+static void remove_at(int i)
+{
+    heap[i].record->queue_slot[heap[i].is_end] = -1;
+    if (i == --heap_size) {
+        return;
+    }
+
+    /* The last event fills the hole and moves whichever way restores the order */
+    place(i, heap[heap_size]);
+    if (sift_up(i) == i) {
+        sift_down(i);
+    }
+}
+
+/*
+ * Slot of a record's start or end event
+ * Returns: the slot, or -1 if that event is not queued
+ */
+static int slot_of(const struct timer_record* record, int is_end)
+{
+    int i = record->queue_slot[is_end];
+
+    if (i >= 0 && i < heap_size && heap[i].record == record && heap[i].is_end == is_end) {
+        return i;
+    }
+    return -1;
+}
+
+/*
+ * Empty the queue
+ */
+void tq_clear(void)
+{
+    heap_size = 0;
+}
+
+/*
+ * Queue an event, O(log n)
+ * Returns: 0 on success, ERROR_CODE if the queue is full
+ */
+int tq_push(time_t deadline, struct timer_record* record, int is_end)
+{
+    if (heap_size >= HEAP_CAPACITY) {
+        record->queue_slot[is_end] = -1;
+        return ERROR_CODE;
+    }
+
+    heap[heap_size].deadline = deadline;
+    heap[heap_size].record = record;
+    heap[heap_size].is_end = is_end;
+    sift_up(heap_size++);
+    return 0;
+}
+
+/*
+ * Drop every pending event belonging to one of records[0..n-1].
+ * A few records are removed one event at a time, O(n log size); a large
+ * set is marked, filtered out in one pass and the heap rebuilt bottom-up,
+ * O(size), so mass cancellation stays linear.
+ */
+void tq_remove_records(struct timer_record* const* records, int n)
+{
+    int i, j, kept;
+
+    if (records == NULL || n <= 0 || heap_size == 0) {
+        return;
+    }
+
+    if (n <= heap_size / REBUILD_RATIO) {
+        for (i = 0; i < n; i++) {
+            for (j = 0; j < 2; j++) {
+                int slot = slot_of(records[i], j);
+
+                if (slot >= 0) {
+                    remove_at(slot);
+                }
+            }
+        }
+        return;
+    }
+
+    /* Mark the doomed events, their records are found through queue_slot[] */
+    for (i = 0; i < n; i++) {
+        for (j = 0; j < 2; j++) {
+            int slot = slot_of(records[i], j);
+
+            if (slot >= 0) {
+                heap[slot].record->queue_slot[j] = -1;
+                heap[slot].record = NULL;
+            }
+        }
+    }
+
+    for (i = 0, kept = 0; i < heap_size; i++) {
+        if (heap[i].record != NULL) {
+            place(kept++, heap[i]);
+        }
+    }
+    if (kept == heap_size) {
+        return;
+    }
+    heap_size = kept;
+
+    if (heap_size > 1) {
+        for (i = (heap_size - 2) / HEAP_ARITY; i >= 0; i--) {
+            sift_down(i);
+        }
+    }
+}
+
+/*
+ * Earliest pending event, O(1)
+ * Returns: pointer into the queue (valid until the next change) or NULL if empty
+ */
+const struct timer_event* tq_peek(void)
+{
+    return (heap_size > 0) ? &heap[0] : NULL;
+}
+
+/*
+ * Remove the earliest event, O(log n)
+ * Returns: 1 if an event was copied to out, 0 if the queue is empty
+ */
+int tq_pop(struct timer_event* out)
+{
+    if (heap_size == 0) {
+        return 0;
+    }
+
+    if (out != NULL) {
+        *out = heap[0];
+    }
+    remove_at(0);
+    return 1;
+}
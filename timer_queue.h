@@ -0,0 +1,18 @@
+
+#ifndef _timer_queue_h_
+#define _timer_queue_h_
+
+#include "timer.h"
+
+/*
+ * Expiry queue internals, kept in sync with the store by timer.c.
+ * The public interface is timer_next_due() and friends in timer.h.
+ */
+void tq_clear(void);
+int  tq_push(time_t deadline, struct timer_record* record, int is_end); /* ERROR_CODE if full */
+void tq_remove_records(struct timer_record* const* records, int n);      /* Drop all events of records, O(log n) each */
+const struct timer_event* tq_peek(void);                                 /* Earliest event or NULL */
+int  tq_pop(struct timer_event* out);                                    /* 1 if an event was popped */
+
+#endif /* _timer_queue_h_ */
+
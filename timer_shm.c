@@ -0,0 +1,186 @@
+
+/*
+ * Publishes the timer store into POSIX shared memory (writer side)
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "consts.h"
+#include "timer.h"
+#include "timer_shm.h"
+
+static struct timer_shm_header* shm_hdr = NULL;
+static size_t shm_size = 0;
+static char shm_name[BUF_SIZE];
+
+/*
+ * Check whether an existing segment may still be in use.
+ * A segment without a valid header may be one another process has just
+ * created and not initialized yet, so only a recorded owner that is
+ * confirmed dead makes it stale.
+ * Returns: 0 if its owner is known to be gone, 1 otherwise
+ */
+static int segment_is_live(const char* name)
+{
+    int fd;
+    struct stat st;
+    void* addr;
+    const struct timer_shm_header* hdr;
+    pid_t owner = 0;
+
+    fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) {
+        /* gone already, or not ours to judge */
+        return errno != ENOENT;
+    }
+
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= TIMER_SHM_SIZE(0)) {
+        addr = mmap(NULL, TIMER_SHM_SIZE(0), PROT_READ, MAP_SHARED, fd, 0);
+        if (addr != MAP_FAILED) {
+            hdr = (const struct timer_shm_header*)addr;
+            if (__atomic_load_n(&hdr->magic, __ATOMIC_ACQUIRE) == TIMER_SHM_MAGIC &&
+                hdr->version == TIMER_SHM_VERSION) {
+                owner = (pid_t)hdr->owner_pid;
+            }
+            munmap(addr, TIMER_SHM_SIZE(0));
+        }
+    }
+    close(fd);
+
+    if (owner <= 0) {
+        return 1;
+    }
+    return kill(owner, 0) == 0 || errno != ESRCH;
+}
+
+/*
+ * Create the segment and map it for writing.
+ * Fails if the name is taken by another process, or by a segment whose
+ * owner cannot be confirmed dead (remove it by hand from /dev/shm); a
+ * segment left behind by a process that died is removed once first.
+ * Returns: 0 on success, ERROR_CODE on failure
+ */
+int timer_shm_open(const char* name, unsigned capacity)
+{
+    int fd;
+    void* addr;
+    size_t size;
+
+    if (shm_hdr != NULL || name == NULL || strlen(name) >= sizeof(shm_name)) {
+        return ERROR_CODE;
+    }
+
+    size = TIMER_SHM_SIZE(capacity);
+
+    fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0 && errno == EEXIST && !segment_is_live(name)) {
+        shm_unlink(name);
+        fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+    }
+    if (fd < 0) {
+        return ERROR_CODE;
+    }
+
+    /* From here on the segment is ours, so the error paths may unlink it */
+
+    if (ftruncate(fd, (off_t)size) != 0) {
+        close(fd);
+        shm_unlink(name);
+        return ERROR_CODE;
+    }
+
+    addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        shm_unlink(name);
+        return ERROR_CODE;
+    }
+
+    shm_hdr = (struct timer_shm_header*)addr;
+    shm_size = size;
+    strcpy(shm_name, name);
+
+    memset(shm_hdr, 0, size);
+    shm_hdr->version = TIMER_SHM_VERSION;
+    shm_hdr->capacity = capacity;
+    shm_hdr->owner_pid = (int32_t)getpid();
+    /* Publish magic last so readers never accept a half-initialized header */
+    __atomic_store_n(&shm_hdr->magic, TIMER_SHM_MAGIC, __ATOMIC_RELEASE);
+
+    return 0;
+}
+
+/*
+ * Unmap and remove the segment
+ */
+void timer_shm_close(void)
+{
+    if (shm_hdr == NULL) {
+        return;
+    }
+
+    munmap(shm_hdr, shm_size);
+    shm_unlink(shm_name);
+    shm_hdr = NULL;
+    shm_size = 0;
+}
+
+/*
+ * Update the segment under the seqlock: slots [first, count) are rewritten
+ * from records, slots before first are assumed unchanged. Pass first = 0
+ * for a full copy, first = count to publish only the count and watchdog.
+ */
+void timer_shm_publish(struct timer_record* const* records, int count, int first,
+                       int wd_enabled, int wd_expired, time_t wd_last_kick,
+                       int wd_timeout)
+{
+    uint32_t seq;
+    int i;
+
+    if (shm_hdr == NULL) {
+        return;
+    }
+
+    if (count < 0) {
+        count = 0;
+    } else if ((unsigned)count > shm_hdr->capacity) {
+        count = (int)shm_hdr->capacity;
+    }
+    if (first < 0) {
+        first = 0;
+    }
+
+    /* Odd sequence: readers back off until the write is complete */
+    seq = shm_hdr->seq;
+    __atomic_store_n(&shm_hdr->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    for (i = first; i < count; i++) {
+        struct timer_shm_record* out = &shm_hdr->records[i];
+
+        if (records[i] != NULL) {
+            out->starttime = (int64_t)records[i]->starttime;
+            out->endtime = (int64_t)records[i]->endtime;
+            out->channel = records[i]->channel;
+        } else {
+            memset(out, 0, sizeof(*out));
+        }
+    }
+
+    shm_hdr->count = (uint32_t)count;
+    shm_hdr->watchdog_enabled = wd_enabled;
+    shm_hdr->watchdog_expired = wd_expired;
+    shm_hdr->watchdog_timeout = wd_timeout;
+    shm_hdr->watchdog_last_kick = (int64_t)wd_last_kick;
+
+    __atomic_store_n(&shm_hdr->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
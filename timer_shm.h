@@ -0,0 +1,86 @@
+
+#ifndef _timer_shm_h_
+#define _timer_shm_h_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+/*
+ * SHARED MEMORY VIEW OF THE TIMER STORE
+ * The owning process publishes its timers into a POSIX shared memory
+ * segment. Other processes map it read-only and read the records in place.
+ * A sequence counter (seqlock) guards the data: it is odd while the owner
+ * is writing, so readers retry whenever it was odd or changed under them.
+ */
+#define TIMER_SHM_NAME    "/timer_store"
+#define TIMER_SHM_MAGIC   0x544d5253u   /* "TMRS" */
+#define TIMER_SHM_VERSION 2
+
+/* fixed width copy of struct timer_record */
+struct timer_shm_record
+{
+    int64_t  starttime;
+    int64_t  endtime;
+    uint32_t channel;
+    uint32_t reserved;
+};
+
+/* segment layout, version TIMER_SHM_VERSION */
+struct timer_shm_header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t seq;                 /* seqlock counter, odd while writing */
+    uint32_t capacity;            /* number of slots in records[] */
+    uint32_t count;               /* number of slots in use */
+    int32_t  watchdog_enabled;
+    int32_t  watchdog_expired;
+    int32_t  watchdog_timeout;
+    int32_t  owner_pid;           /* process publishing the segment */
+    uint32_t reserved;
+    int64_t  watchdog_last_kick;
+    struct timer_shm_record records[1];  /* really capacity slots, see TIMER_SHM_SIZE */
+};
+
+/*
+ * Bytes of a segment with the given number of record slots.
+ * records[] is declared with one slot so the header is valid C++ too;
+ * do not size segments with sizeof(struct timer_shm_header).
+ */
+#define TIMER_SHM_SIZE(capacity) \
+    (offsetof(struct timer_shm_header, records) + \
+     (size_t)(capacity) * sizeof(struct timer_shm_record))
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct timer_record;
+
+/* writer side, used by the owning process */
+int  timer_shm_open(const char* name, unsigned capacity); /* ERROR_CODE on failure */
+void timer_shm_close(void);                               /* Unmap and unlink the segment */
+void timer_shm_publish(struct timer_record* const* records, int count, int first,
+                       int wd_enabled, int wd_expired, time_t wd_last_kick,
+                       int wd_timeout);                   /* Rewrite slots [first, count), no-op if not open */
+
+/* reader side, see timer_shm_reader.c */
+struct timer_shm_view
+{
+    const struct timer_shm_header* hdr;
+    size_t size;
+};
+
+int      timer_shm_attach(struct timer_shm_view*, const char* name); /* ERROR_CODE on failure */
+void     timer_shm_detach(struct timer_shm_view*);
+int      timer_shm_read_begin(const struct timer_shm_view*, uint32_t*); /* Start a read section, ERROR_CODE if no write completes */
+int      timer_shm_read_retry(const struct timer_shm_view*, uint32_t); /* 1 if the section must be retried */
+unsigned timer_shm_count(const struct timer_shm_view*);              /* Record count, clamped to capacity */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _timer_shm_h_ */
+
@@ -0,0 +1,149 @@
+
+/*
+ * Read-only access to the shared memory timer store (reader side)
+ *
+ * Typical read:
+ *     do {
+ *         if (timer_shm_read_begin(&view, &seq) == ERROR_CODE) {
+ *             ... the owner died or is stuck mid-write, give up ...
+ *         }
+ *         ... read view.hdr fields and records in place ...
+ *     } while (timer_shm_read_retry(&view, seq));
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "consts.h"
+#include "timer_shm.h"
+
+#define READ_SPINS   1000   /* busy polls before the reader starts sleeping */
+#define READ_WAIT_MS 1000   /* longest wait for a write to complete */
+
+/*
+ * Map an existing segment read-only and check its layout
+ * Returns: 0 on success, ERROR_CODE on failure
+ */
+int timer_shm_attach(struct timer_shm_view* view, const char* name)
+{
+    int fd;
+    struct stat st;
+    void* addr;
+    const struct timer_shm_header* hdr;
+
+    if (view == NULL || name == NULL) {
+        return ERROR_CODE;
+    }
+    view->hdr = NULL;
+    view->size = 0;
+
+    fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) {
+        return ERROR_CODE;
+    }
+
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < TIMER_SHM_SIZE(0)) {
+        close(fd);
+        return ERROR_CODE;
+    }
+
+    addr = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        return ERROR_CODE;
+    }
+
+    hdr = (const struct timer_shm_header*)addr;
+    if (__atomic_load_n(&hdr->magic, __ATOMIC_ACQUIRE) != TIMER_SHM_MAGIC ||
+        hdr->version != TIMER_SHM_VERSION ||
+        TIMER_SHM_SIZE(hdr->capacity) > (size_t)st.st_size) {
+        munmap(addr, (size_t)st.st_size);
+        return ERROR_CODE;
+    }
+
+    view->hdr = hdr;
+    view->size = (size_t)st.st_size;
+    return 0;
+}
+
+/*
+ * Unmap the segment
+ */
+void timer_shm_detach(struct timer_shm_view* view)
+{
+    if (view == NULL || view->hdr == NULL) {
+        return;
+    }
+
+    munmap((void*)view->hdr, view->size);
+    view->hdr = NULL;
+    view->size = 0;
+}
+
+/*
+ * Returns: 1 if the process publishing the segment is gone
+ */
+static int owner_is_dead(const struct timer_shm_view* view)
+{
+    pid_t owner = (pid_t)__atomic_load_n(&view->hdr->owner_pid, __ATOMIC_RELAXED);
+
+    return owner > 0 && kill(owner, 0) != 0 && errno == ESRCH;
+}
+
+/*
+ * Start a read section, waiting while the owner is mid-write.
+ * Spins briefly, then polls every millisecond for up to READ_WAIT_MS,
+ * giving up early if the owner died inside a write.
+ * Returns: 0 and sets *seq for timer_shm_read_retry(), or ERROR_CODE
+ */
+int timer_shm_read_begin(const struct timer_shm_view* view, uint32_t* seq)
+{
+    struct timespec pause = { 0, 1000000 };
+    int i;
+
+    for (i = 0; i < READ_SPINS + READ_WAIT_MS; i++) {
+        *seq = __atomic_load_n(&view->hdr->seq, __ATOMIC_ACQUIRE);
+        if ((*seq & 1) == 0) {
+            return 0;
+        }
+        if (i >= READ_SPINS) {
+            if (owner_is_dead(view)) {
+                return ERROR_CODE;
+            }
+            nanosleep(&pause, NULL);
+        }
+    }
+    return ERROR_CODE;
+}
+
+/*
+ * End a read section
+ * Returns: 1 if the store changed while reading and the data must be re-read
+ */
+int timer_shm_read_retry(const struct timer_shm_view* view, uint32_t seq)
+{
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&view->hdr->seq, __ATOMIC_RELAXED) != seq;
+}
+
+/*
+ * Number of records, never more than the segment holds
+ * (count can be torn inside a read section, so always go through here)
+ */
+unsigned timer_shm_count(const struct timer_shm_view* view)
+{
+    unsigned count = view->hdr->count;
+
+    if (count > view->hdr->capacity) {
+        count = view->hdr->capacity;
+    }
+    return count;
+}
+
@@ -0,0 +1,277 @@
+
+/*
+ * Behavior checks for the timer store: batch transactions and the
+ * expiry queue.
+ * Exits with the number of failed checks, so 0 means everything passed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "consts.h"
+#include "timer.h"
+
+static int failures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+            failures++; \
+        } \
+    } while (0)
+
+/*
+ * Allocate a record starting at start, ending a minute later
+ */
+static struct timer_record* new_record(time_t start, unsigned channel)
+{
+    struct timer_record* tr = timer_record_alloc();
+
+    if (tr == NULL) {
+        fprintf(stderr, "out of records\n");
+        exit(1);
+    }
+    memset(tr, 0, sizeof(*tr));
+    tr->starttime = start;
+    tr->endtime = start + 60;
+    tr->channel = channel;
+    return tr;
+}
+
+/*
+ * Channel of the record at idx, read back through the listing format
+ * Returns: the channel, or -1 if there is no record
+ */
+static int channel_at(int idx)
+{
+    char buf[BUF_SIZE];
+    const char* tab;
+
+    if (format_timer_record_r(idx, buf, sizeof(buf)) == 0) {
+        return -1;
+    }
+    tab = strrchr(buf, '\t');
+    return (tab != NULL) ? atoi(tab + 1) : -1;
+}
+
+/*
+ * Empty the store and fill it with records of channels 0..n-1
+ */
+static void fill_store(int n)
+{
+    int i;
+
+    uninit_timer();
+    init_timer();
+    for (i = 0; i < n; i++) {
+        add_timer_record(new_record(1000 + i, (unsigned)i));
+    }
+}
+
+static void test_batch_applies_all(void)
+{
+    struct timer_batch batch;
+    struct timer_record* adds[2];
+    int deletes[3];
+
+    fill_store(4);
+    timer_batch_init(&batch, adds, 2, deletes, 3);
+    CHECK(timer_batch_delete(&batch, 0) == 0);
+    CHECK(timer_batch_delete(&batch, 2) == 0);
+    CHECK(timer_batch_delete(&batch, 2) == 0);     /* duplicate deletes collapse */
+    CHECK(timer_batch_add(&batch, new_record(2000, 10)) == 0);
+
+    CHECK(timer_batch_apply(&batch) == 0);
+    CHECK(timer_count() == 3);
+    CHECK(channel_at(0) == 1);
+    CHECK(channel_at(1) == 3);
+    CHECK(channel_at(2) == 10);
+    CHECK(batch.num_adds == 0 && batch.num_deletes == 0);
+}
+
+static void test_batch_is_all_or_nothing(void)
+{
+    struct timer_batch batch;
+    struct timer_record* adds[1];
+    struct timer_record* tr;
+    int deletes[2];
+
+    fill_store(3);
+    timer_batch_init(&batch, adds, 1, deletes, 2);
+    tr = new_record(2000, 10);
+    CHECK(timer_batch_delete(&batch, 1) == 0);
+    CHECK(timer_batch_delete(&batch, 3) == 0);     /* out of range */
+    CHECK(timer_batch_add(&batch, tr) == 0);
+
+    CHECK(timer_batch_apply(&batch) == ERROR_CODE);
+    CHECK(timer_count() == 3);
+    CHECK(channel_at(0) == 0 && channel_at(1) == 1 && channel_at(2) == 2);
+    timer_record_free(tr);
+}
+
+static void test_batch_rejects_duplicate_adds(void)
+{
+    struct timer_batch batch;
+    struct timer_record* adds[2];
+    struct timer_record* tr;
+
+    fill_store(2);
+    timer_batch_init(&batch, adds, 2, NULL, 0);
+    tr = new_record(2000, 10);
+    CHECK(timer_batch_add(&batch, tr) == 0);
+    CHECK(timer_batch_add(&batch, tr) == 0);
+
+    CHECK(timer_batch_apply(&batch) == ERROR_CODE);
+    CHECK(timer_count() == 2);
+    timer_record_free(tr);
+}
+
+static void test_batch_rejects_stored_adds(void)
+{
+    struct timer_batch batch;
+    struct timer_record* adds[1];
+    int deletes[1];
+    struct timer_record* tr;
+
+    uninit_timer();
+    init_timer();
+    tr = new_record(1000, 0);
+    add_timer_record(tr);
+
+    /* also when the same batch deletes it: the store would free it first */
+    timer_batch_init(&batch, adds, 1, deletes, 1);
+    CHECK(timer_batch_delete(&batch, 0) == 0);
+    CHECK(timer_batch_add(&batch, tr) == 0);
+
+    CHECK(timer_batch_apply(&batch) == ERROR_CODE);
+    CHECK(timer_count() == 1);
+    CHECK(channel_at(0) == 0);
+}
+
+static void test_batch_limits(void)
+{
+    struct timer_batch batch;
+    struct timer_record* adds[1];
+    struct timer_record* tr;
+
+    /* the caller's arrays bound the batch */
+    timer_batch_init(&batch, adds, 1, NULL, 0);
+    tr = new_record(2000, 10);
+    CHECK(timer_batch_add(&batch, tr) == 0);
+    CHECK(timer_batch_add(&batch, tr) == ERROR_CODE);
+    CHECK(timer_batch_delete(&batch, 0) == ERROR_CODE);
+
+    /* the store's capacity bounds the result */
+    fill_store(TIMER_CAPACITY);
+    CHECK(timer_batch_apply(&batch) == ERROR_CODE);
+    CHECK(timer_count() == TIMER_CAPACITY);
+    timer_record_free(tr);
+}
+
+/*
+ * Pop everything due by now, checking the events come out earliest first
+ * Returns: number of events popped
+ */
+static int drain_in_order(time_t now, time_t* last)
+{
+    struct timer_event events[8];
+    int n, i, total = 0;
+
+    while ((n = timer_drain_expired(now, events, 8)) > 0) {
+        for (i = 0; i < n; i++) {
+            CHECK(events[i].deadline >= *last);
+            CHECK(events[i].deadline <= now);
+            *last = events[i].deadline;
+        }
+        total += n;
+    }
+    return total;
+}
+
+static void test_queue_orders_events(void)
+{
+    struct timer_event ev;
+    time_t due, last = 0;
+    int i;
+
+    uninit_timer();
+    init_timer();
+    CHECK(timer_next_due(&due) == ERROR_CODE);
+    CHECK(timer_pop_expired(1000000, &ev) == 0);
+
+    /* scrambled starts, each record ends a minute after it starts */
+    for (i = 0; i < 40; i++) {
+        add_timer_record(new_record(1000 + (i * 37) % 40 * 10, (unsigned)i));
+    }
+    CHECK(timer_next_due(&due) == 0 && due == 1000);
+
+    /* nothing is due before the first start */
+    CHECK(timer_pop_expired(999, &ev) == 0);
+    CHECK(timer_pop_expired(1000, &ev) == 1);
+    CHECK(ev.deadline == 1000 && ev.is_end == 0 && ev.record->channel == 0);
+
+    /* drain stops at the limit and at now */
+    CHECK(drain_in_order(1200, &last) == 21 + 15 - 1);     /* starts to 1200, ends to 1140 */
+    CHECK(timer_next_due(&due) == 0 && due > 1200);
+    CHECK(drain_in_order(1000000, &last) == 80 - 36);
+    CHECK(timer_next_due(&due) == ERROR_CODE);
+}
+
+static void test_queue_follows_deletes(void)
+{
+    time_t due, last = 0;
+    int i;
+
+    fill_store(40);
+    CHECK(timer_next_due(&due) == 0 && due == 1000);
+
+    /* the earliest record goes, so does its deadline */
+    delete_timer_record(0);
+    CHECK(timer_next_due(&due) == 0 && due == 1001);
+    CHECK(drain_in_order(1000000, &last) == 2 * 39);
+
+    /* a large batch takes the filter and rebuild path */
+    {
+        struct timer_batch batch;
+        int deletes[30];
+
+        fill_store(40);
+        timer_batch_init(&batch, NULL, 0, deletes, 30);
+        for (i = 0; i < 30; i++) {
+            CHECK(timer_batch_delete(&batch, i) == 0);
+        }
+        CHECK(timer_batch_apply(&batch) == 0);
+        CHECK(timer_next_due(&due) == 0 && due == 1030);
+        last = 0;
+        CHECK(drain_in_order(1000000, &last) == 2 * 10);
+    }
+
+    /* a record whose start already popped still loses its end */
+    fill_store(40);
+    CHECK(timer_pop_expired(1000, NULL) == 1);
+    delete_timer_record(0);
+    CHECK(timer_next_due(&due) == 0 && due == 1001);
+    last = 0;
+    CHECK(drain_in_order(1000000, &last) == 2 * 39);
+}
+
+int main()
+{
+    init_timer();
+
+    test_batch_applies_all();
+    test_batch_is_all_or_nothing();
+    test_batch_rejects_duplicate_adds();
+    test_batch_rejects_stored_adds();
+    test_batch_limits();
+    test_queue_orders_events();
+    test_queue_follows_deletes();
+
+    uninit_timer();
+    if (failures > 0) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+    }
+    return failures;
+}